@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Non-owning view of bytes that live in an Arena (or any buffer that
+// outlives it).
+struct StringRef {
+    const char* data;
+    uint32_t size;
+
+    StringRef() : data(""), size(0) {}
+    StringRef(const char* d, uint32_t s) : data(d), size(s) {}
+
+    size_t length() const { return size; }
+    bool empty() const { return size == 0; }
+    std::string str() const { return std::string(data, size); }
+
+    bool operator==(const StringRef& other) const {
+        return size == other.size && std::memcmp(data, other.data, size) == 0;
+    }
+    bool operator!=(const StringRef& other) const { return !(*this == other); }
+};
+
+// Bump allocator. Objects are carved out of large blocks and never
+// destroyed individually: everything is released at once when the arena
+// goes away, so only trivially destructible types may live here.
+class Arena {
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextBlockSize;
+    size_t reserved = 0;
+
+    void grow(size_t minSize) {
+        size_t size = minSize > nextBlockSize ? minSize : nextBlockSize;
+        blocks.emplace_back(new char[size]);
+        cursor = blocks.back().get();
+        limit = cursor + size;
+        reserved += size;
+        if (nextBlockSize < (1u << 20)) nextBlockSize *= 2;
+    }
+
+public:
+    explicit Arena(size_t firstBlockSize = 4096) : nextBlockSize(firstBlockSize) {}
+    Arena(Arena&& other)
+        : blocks(std::move(other.blocks)), cursor(other.cursor), limit(other.limit),
+          nextBlockSize(other.nextBlockSize), reserved(other.reserved) {
+        other.cursor = other.limit = nullptr;
+        other.reserved = 0;
+    }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+        if (!cursor || p + size > reinterpret_cast<uintptr_t>(limit)) {
+            grow(size + align);
+            p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+        }
+        cursor = reinterpret_cast<char*>(p + size);
+        return reinterpret_cast<void*>(p);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* copyArray(const T* items, size_t count) {
+        if (count == 0) return nullptr;
+        T* out = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::memcpy(out, items, sizeof(T) * count);
+        return out;
+    }
+
+    StringRef copyString(const char* data, size_t size) {
+        if (size == 0) return StringRef();
+        char* out = static_cast<char*>(allocate(size, 1));
+        std::memcpy(out, data, size);
+        return StringRef(out, static_cast<uint32_t>(size));
+    }
+    StringRef copyString(const std::string& s) { return copyString(s.data(), s.size()); }
+
+    size_t bytesReserved() const { return reserved; }
+};
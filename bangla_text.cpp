@@ -0,0 +1,123 @@
+#include "bangla_text.h"
+
+// LetterClass of U+0980 + i, sixteen code points per row
+#define O 0
+#define V 1
+#define K 2
+#define C 3
+#define D 4
+const uint8_t banglaLetterClasses[128] = {
+    O, C, C, C, O, V, V, V, V, V, V, V, O, O, O, V,  // U+0980  ঁ ং ঃ, অ-ঋ, এ
+    V, O, O, V, V, C, C, C, C, C, C, C, C, C, C, C,  // U+0990  ঐ, ও ঔ, ক-ট
+    C, C, C, C, C, C, C, C, C, O, C, C, C, C, C, C,  // U+09A0  ঠ-ন, প-য
+    C, O, C, O, O, O, C, C, C, C, O, O, O, O, K, K,  // U+09B0  র, ল, শ-হ, া ি
+    K, K, K, K, O, O, O, K, K, O, O, K, K, O, C, O,  // U+09C0  ী-ৃ, ে ৈ, ো ৌ, ৎ
+    O, O, O, O, O, O, O, K, O, O, O, O, C, C, O, C,  // U+09D0  ৗ, ড় ঢ়, য়
+    O, O, O, O, O, O, D, D, D, D, D, D, D, D, D, D,  // U+09E0  ০-৯
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O   // U+09F0
+};
+#undef O
+#undef V
+#undef K
+#undef C
+#undef D
+
+LetterCounts countLetters(const char* data, size_t size) {
+    LetterCounts counts;
+    counts.codePoints = forEachLetter(data, size, [&counts](LetterClass cls, size_t, size_t) {
+        switch (cls) {
+            case LetterClass::VOWEL: counts.vowels++; break;
+            case LetterClass::VOWEL_SIGN: counts.vowelSigns++; break;
+            case LetterClass::CONSONANT: counts.consonants++; break;
+            case LetterClass::DIGIT: counts.digits++; break;
+            default: break;
+        }
+        return true;
+    });
+    return counts;
+}
+
+size_t findLetter(const char* data, size_t size, LetterClass cls) {
+    size_t found = NO_LETTER;
+    forEachLetter(data, size, [cls, &found](LetterClass letter, size_t index, size_t) {
+        if (letter != cls) return true;
+        found = index;
+        return false;
+    });
+    return found;
+}
+
+// The vowels are E0 A6 followed by 85-8B (অ-ঋ), 8F 90 (এ ঐ) or 93 94 (ও ঔ)
+static bool isVowelTail(unsigned char c) {
+    return (c >= 0x85 && c <= 0x8B) || c == 0x8F || c == 0x90 || c == 0x93 || c == 0x94;
+}
+
+#if defined(__AVX2__)
+
+static uint32_t vowelMask(const char* p) {
+    __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    __m256i third = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+    #define BANGLA_IN_RANGE(lo, span) \
+        _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(third, _mm256_set1_epi8(lo)), \
+                                          _mm256_set1_epi8(span)), \
+                          _mm256_sub_epi8(third, _mm256_set1_epi8(lo)))
+    __m256i tail = _mm256_or_si256(BANGLA_IN_RANGE(static_cast<char>(0x85), 6),
+                                   BANGLA_IN_RANGE(static_cast<char>(0x8F), 1));
+    tail = _mm256_or_si256(tail, BANGLA_IN_RANGE(static_cast<char>(0x93), 1));
+    #undef BANGLA_IN_RANGE
+    __m256i m = _mm256_and_si256(_mm256_cmpeq_epi8(first, _mm256_set1_epi8(static_cast<char>(0xE0))),
+                                 _mm256_cmpeq_epi8(second, _mm256_set1_epi8(static_cast<char>(0xA6))));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(m, tail)));
+}
+
+#elif defined(BANGLA_SCAN_WIDTH)
+
+static uint32_t vowelMask(const char* p) {
+    __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    __m128i third = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+    #define BANGLA_IN_RANGE(lo, span) \
+        _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(third, _mm_set1_epi8(lo)), _mm_set1_epi8(span)), \
+                       _mm_sub_epi8(third, _mm_set1_epi8(lo)))
+    __m128i tail = _mm_or_si128(BANGLA_IN_RANGE(static_cast<char>(0x85), 6),
+                                BANGLA_IN_RANGE(static_cast<char>(0x8F), 1));
+    tail = _mm_or_si128(tail, BANGLA_IN_RANGE(static_cast<char>(0x93), 1));
+    #undef BANGLA_IN_RANGE
+    __m128i m = _mm_and_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8(static_cast<char>(0xE0))),
+                              _mm_cmpeq_epi8(second, _mm_set1_epi8(static_cast<char>(0xA6))));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(m, tail)));
+}
+
+#endif
+
+bool containsVowel(const char* data, size_t size) {
+    size_t i = 0;
+#ifdef BANGLA_SCAN_WIDTH
+    // Lane j of a step looks at the three bytes starting at i + j
+    while (i + BANGLA_SCAN_WIDTH + 2 <= size) {
+        if (vowelMask(data + i)) return true;
+        i += BANGLA_SCAN_WIDTH;
+    }
+#endif
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    for (; i + 2 < size; i++) {
+        if (p[i] == 0xE0 && p[i + 1] == 0xA6 && isVowelTail(p[i + 2])) return true;
+    }
+    return false;
+}
+
+int runTextQuery(int query, const char* data, size_t size) {
+    switch (static_cast<TextQuery>(query)) {
+        case TextQuery::VOWEL_COUNT:
+            return static_cast<int>(countLetters(data, size).vowels);
+        case TextQuery::CONSONANT_COUNT:
+            return static_cast<int>(countLetters(data, size).consonants);
+        case TextQuery::FIRST_VOWEL:
+            {
+                size_t index = findLetter(data, size, LetterClass::VOWEL);
+                return index == NO_LETTER ? -1 : static_cast<int>(index);
+            }
+    }
+    return 0;
+}
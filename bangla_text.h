@@ -0,0 +1,80 @@
+#pragma once
+#include "scanner.h"
+#include <cstddef>
+#include <cstdint>
+
+// Letter classes of the Bengali block (U+0980-U+09FF). Vowels are the
+// eleven of the modern alphabet, অ আ ই ঈ উ ঊ ঋ এ ঐ ও ঔ; the archaic
+// ঌ ৠ ৡ are not counted. Consonants are the thirty-nine from ক to ঁ,
+// including ড় ঢ় য় ৎ ং ঃ. Vowel signs are the kars (া ি ী ু ূ ৃ ে ৈ ো ৌ ৗ).
+// Everything else, hasant and nukta included, is OTHER.
+enum class LetterClass : uint8_t { OTHER, VOWEL, VOWEL_SIGN, CONSONANT, DIGIT };
+
+extern const uint8_t banglaLetterClasses[128];
+
+inline LetterClass classifyCodePoint(uint32_t cp) {
+    return cp - 0x980u < 128 ? static_cast<LetterClass>(banglaLetterClasses[cp - 0x980u])
+                             : LetterClass::OTHER;
+}
+
+// Calls visit(cls, index, offset) for every letter of data that is not
+// OTHER, where index counts code points and offset bytes. Returning false
+// from visit stops the scan. Malformed UTF-8 counts one code point per
+// byte, as utf8Decode does. Returns the number of code points scanned.
+//
+// Bengali code points are all E0 A6 xx or E0 A7 xx, so they are classified
+// from the last two bytes without a full decode, and runs of ASCII are
+// skipped a vector at a time.
+template <typename Visitor>
+size_t forEachLetter(const char* data, size_t size, Visitor visit) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0, index = 0;
+    while (i < size) {
+        if (p[i] < 0x80) {
+            size_t end = skipAscii(data, i, size);
+            index += end - i;
+            i = end;
+            continue;
+        }
+        if (p[i] == 0xE0 && i + 2 < size && (p[i + 1] & 0xFE) == 0xA6 && (p[i + 2] & 0xC0) == 0x80) {
+            LetterClass cls = static_cast<LetterClass>(
+                banglaLetterClasses[((p[i + 1] & 1u) << 6) | (p[i + 2] & 0x3Fu)]);
+            if (cls != LetterClass::OTHER && !visit(cls, index, i)) return index;
+            i += 3;
+        } else {
+            size_t length = utf8SequenceLength(p + i, size - i);
+            i += length ? length : 1;
+        }
+        index++;
+    }
+    return index;
+}
+
+struct LetterCounts {
+    size_t codePoints = 0;
+    size_t vowels = 0;
+    size_t vowelSigns = 0;
+    size_t consonants = 0;
+    size_t digits = 0;
+};
+
+LetterCounts countLetters(const char* data, size_t size);
+
+// Code point index of the first letter of class cls, or NO_LETTER
+const size_t NO_LETTER = static_cast<size_t>(-1);
+size_t findLetter(const char* data, size_t size, LetterClass cls);
+
+// True if data contains one of the eleven vowels. This is a byte search
+// for their UTF-8 forms, like the std::string::find calls স্বরবর্ণচেক
+// used to make, done for all eleven in one vectorized pass.
+bool containsVowel(const char* data, size_t size);
+
+// The text built-ins. The keyword table stores the query as the token
+// value; each one takes a string literal and yields a number.
+enum class TextQuery {
+    VOWEL_COUNT,      // স্বরবর্ণসংখ্যা("...")
+    CONSONANT_COUNT,  // ব্যঞ্জনসংখ্যা("...")
+    FIRST_VOWEL       // স্বরবর্ণঅবস্থান("..."): code point index, -1 if none
+};
+
+int runTextQuery(int query, const char* data, size_t size);
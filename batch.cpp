@@ -0,0 +1,66 @@
+#include "batch.h"
+#include "server.h"
+#include "json.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <iostream>
+
+std::vector<RunResult> runBatch(const std::vector<std::string>& sources,
+                                const RunOptions& options, unsigned threads) {
+    std::vector<RunResult> results(sources.size());
+    ThreadPool pool(threads);
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        // Each task writes only its own slot, so no locking is needed
+        pool.submit([&sources, &results, &options, i] {
+            results[i] = runSource(sources[i], options);
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+int runBatchFile(const std::string& path, const RunOptions& options,
+                 unsigned threads, std::ostream& out) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open " << path << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+    std::vector<size_t> lineNumbers;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); number++) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+        lines.push_back(line);
+        lineNumbers.push_back(number);
+    }
+
+    std::vector<std::string> responses(lines.size());
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < lines.size(); i++) {
+            pool.submit([&lines, &lineNumbers, &responses, &options, i] {
+                const std::string& text = lines[i];
+                size_t first = text.find_first_not_of(" \t");
+                JsonObject request;
+                std::string error;
+                if (text[first] == '{' && parseJsonObject(text, request, error)) {
+                    responses[i] = handleRequest(text, options);
+                } else {
+                    responses[i] = formatResponse(std::to_string(lineNumbers[i]),
+                                                  runSource(text, options));
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    for (const auto& response : responses) {
+        out << response << '\n';
+    }
+    out.flush();
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "runner.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Runs independent programs across a work-stealing thread pool. Every
+// program gets its own lexer, parser, engine and output buffer; results
+// come back in input order. threads == 0 uses every hardware thread.
+std::vector<RunResult> runBatch(const std::vector<std::string>& sources,
+                                const RunOptions& options, unsigned threads = 0);
+
+// Grades a whole file at once. Each non-empty line is either a JSON
+// request in the server format or a bare program (whose id is its line
+// number); a line is a request if it parses as a JSON object, so a
+// program may start with a block. Writes one JSON response per line, in input order, and
+// returns non-zero if the file cannot be read.
+int runBatchFile(const std::string& path, const RunOptions& options,
+                 unsigned threads, std::ostream& out);
@@ -0,0 +1,335 @@
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "closure_engine.h"
+#include "compiler.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "vm.h"
+#include "json.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Benchmark driver, built as its own executable (see README.md). Every
+// workload is a synthetic program; each stage (lexing, parsing, the tree
+// evaluator, closure compile + run and compile + VM) is timed on its own and the best of
+// --repeat runs is kept. One JSON object per workload goes to stdout,
+// then {"peakRssKb":N} for the process as a whole:
+//
+//   bangla_bench [--scale N] [--repeat N] [--only NAME] [--optimize]
+//
+// ops is the number of operators the program executes (arithmetic,
+// comparisons, assignments, লেখ and স্বরবর্ণচেক), counted by the
+// generator, so opsPerSec means the same thing for every engine.
+// peakHeapKb is the most heap a workload had allocated at once, over what
+// was allocated before it started.
+
+// Heap accounting for peakHeapKb: every block carries its size in front
+namespace {
+const size_t HEAP_HEADER = alignof(std::max_align_t);
+size_t heapInUse = 0, heapPeak = 0;
+}
+
+void* operator new(size_t size) {
+    void* block = std::malloc(size + HEAP_HEADER);
+    if (!block) throw std::bad_alloc();
+    *static_cast<size_t*>(block) = size;
+    heapInUse += size;
+    heapPeak = std::max(heapPeak, heapInUse);
+    return static_cast<char*>(block) + HEAP_HEADER;
+}
+
+void operator delete(void* memory) noexcept {
+    if (!memory) return;
+    char* block = static_cast<char*>(memory) - HEAP_HEADER;
+    heapInUse -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return operator new(size, std::nothrow); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { operator delete(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { operator delete(memory); }
+
+namespace {
+
+struct Workload {
+    std::string name;
+    std::string source;
+    uint64_t ops = 0;
+};
+
+// Discards program output so the sink never shows up in the timings
+class NullSink : public OutputSink {
+public:
+    void write(const char*, size_t) override {}
+};
+
+const char* const OPERATORS[] = {" + ", " * ", " - ", " / "};
+
+// Statements whose right-hand side is a left-nested chain of depth
+// operators, e.g. ((((x + 1) * 2) - 3) / 4)
+Workload nestedExpressions(int scale) {
+    Workload w;
+    w.name = "nested_expressions";
+    const int statements = 500 * scale, depth = 200;
+    std::string expr = "x";
+    for (int d = 0; d < depth; d++) {
+        expr = "(" + expr + OPERATORS[d % 4] + std::to_string(d % 9 + 1) + ")";
+    }
+    w.source = "x = 1;\n";
+    for (int s = 0; s < statements; s++) {
+        w.source += "x = " + expr + ";\n";
+    }
+    w.ops = 1 + static_cast<uint64_t>(statements) * (depth + 1);
+    return w;
+}
+
+// A counted প্রতিবার loop with an arithmetic body
+Workload countedLoop(int scale) {
+    Workload w;
+    w.name = "counted_loop";
+    const int n = 2000000 * scale;
+    w.source = "s = 0;\nপ্রতিবার (i = 0; i < " + std::to_string(n) +
+               "; i = i + 1) { s = s + i * 3 - i / 7; }\nলেখ s;\n";
+    // Per iteration: test, five in the body, two in the increment
+    w.ops = 2 + static_cast<uint64_t>(n) * 8 + 1 + 1;
+    return w;
+}
+
+// A যতক্ষণ loop with a যদি-নাহলে in the body
+Workload branchyLoop(int scale) {
+    Workload w;
+    w.name = "branchy_loop";
+    const int n = 1000000 * scale;
+    w.source = "x = 0; e = 0; o = 0;\nযতক্ষণ (x < " + std::to_string(n) +
+               ") { যদি (x / 2 * 2 == x) { e = e + 1; } নাহলে { o = o + 1; } x = x + 1; }\n"
+               "লেখ e; লেখ o;\n";
+    // Per iteration: test, three in the condition, two per branch, two more
+    w.ops = 3 + static_cast<uint64_t>(n) * 8 + 1 + 2;
+    return w;
+}
+
+// Many distinct variables, each defined from the one before
+Workload manyIdentifiers(int scale) {
+    Workload w;
+    w.name = "many_identifiers";
+    const int n = 20000 * scale;
+    w.source = "v0 = 1;\n";
+    for (int i = 1; i < n; i++) {
+        w.source += "v" + std::to_string(i) + " = v" + std::to_string(i - 1) + " + " +
+                    std::to_string(i % 9 + 1) + ";\n";
+    }
+    w.source += "লেখ v" + std::to_string(n - 1) + ";\n";
+    w.ops = 1 + static_cast<uint64_t>(n - 1) * 2 + 1;
+    return w;
+}
+
+// Long Bangla string literals, printed and checked for vowels
+Workload largeStrings(int scale) {
+    Workload w;
+    w.name = "large_strings";
+    const int statements = 200 * scale;
+    std::string text;
+    while (text.size() < 16384) text += "বাংলা ভাষায় প্রোগ্রামিং শেখা আনন্দের ";
+    for (int s = 0; s < statements; s++) {
+        w.source += "লেখ \"" + text + "\";\nস্বরবর্ণচেক(\"" + text + "\");\n";
+    }
+    w.ops = static_cast<uint64_t>(statements) * 2;
+    return w;
+}
+
+size_t countNodes(const ASTNode* node) {
+    if (!node) return 0;
+    size_t count = 1 + countNodes(node->left) + countNodes(node->right) + countNodes(node->extra);
+    for (const ASTNode* child : node->children) {
+        count += countNodes(child);
+    }
+    return count;
+}
+
+size_t peakResidentKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;  // bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+typedef std::chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double perSecond(double count, double ms) {
+    return ms > 0 ? count * 1000.0 / ms : 0;
+}
+
+std::string number(double value) {
+    std::ostringstream out;
+    out.precision(6);
+    out << value;
+    return out.str();
+}
+
+// Best time of each stage over repeat runs
+struct StageTimes {
+    double lex = 1e300, parse = 1e300, evaluate = 1e300, closures = 1e300, vm = 1e300, ssa = 1e300;
+};
+
+void runWorkload(const Workload& w, int repeat, bool optimize, std::ostream& report) {
+    StageTimes best;
+    size_t tokenCount = 0, nodeCount = 0, arenaBytes = 0, chunkSize = 0, ssaChunkSize = 0;
+    NullSink sink;
+    const size_t heapBefore = heapInUse;
+    heapPeak = heapInUse;
+
+    for (int r = 0; r < repeat; r++) {
+        Clock::time_point start = Clock::now();
+        Lexer lexer(w.source);
+        std::vector<Token> tokens = lexer.tokenize();
+        best.lex = std::min(best.lex, millisecondsSince(start));
+
+        start = Clock::now();
+        Parser parser(tokens, lexer);
+        Program program = parser.parseProgram();
+        best.parse = std::min(best.parse, millisecondsSince(start));
+
+        if (optimize) {
+            Optimizer optimizer;
+            optimizer.optimize(program);
+        }
+
+        start = Clock::now();
+        Evaluator evaluator;
+        evaluator.setOutput(sink);
+        evaluator.executeProgram(program);
+        best.evaluate = std::min(best.evaluate, millisecondsSince(start));
+
+        start = Clock::now();
+        ClosureEngine closures;
+        closures.setOutput(sink);
+        if (!closures.run(program)) throw std::runtime_error("Expressions too deep for closures");
+        best.closures = std::min(best.closures, millisecondsSince(start));
+
+        start = Clock::now();
+        Compiler compiler;
+        Chunk chunk = compiler.compile(program);
+        VM vm;
+        vm.setOutput(sink);
+        vm.run(chunk);
+        best.vm = std::min(best.vm, millisecondsSince(start));
+
+        // Through the SSA IR, optimizing and lowering included
+        start = Clock::now();
+        IrBuilder builder;
+        IrProgram ir = builder.build(program);
+        IrOptimizer irOptimizer;
+        irOptimizer.optimize(ir);
+        IrLowering lowering;
+        Chunk ssaChunk = lowering.lower(ir);
+        VM ssaVm;
+        ssaVm.setOutput(sink);
+        ssaVm.run(ssaChunk);
+        best.ssa = std::min(best.ssa, millisecondsSince(start));
+
+        tokenCount = tokens.size();
+        nodeCount = countNodes(program.root);
+        arenaBytes = program.arena.bytesReserved();
+        chunkSize = chunk.code.size();
+        ssaChunkSize = ssaChunk.code.size();
+    }
+
+    report << "{\"workload\":" << jsonQuote(w.name)
+           << ",\"sourceBytes\":" << w.source.size()
+           << ",\"tokens\":" << tokenCount
+           << ",\"nodes\":" << nodeCount
+           << ",\"instructions\":" << chunkSize
+           << ",\"ops\":" << w.ops
+           << ",\"lexMs\":" << number(best.lex)
+           << ",\"tokensPerSec\":" << number(perSecond(tokenCount, best.lex))
+           << ",\"parseMs\":" << number(best.parse)
+           << ",\"nodesPerSec\":" << number(perSecond(nodeCount, best.parse))
+           << ",\"evalMs\":" << number(best.evaluate)
+           << ",\"evalOpsPerSec\":" << number(perSecond(static_cast<double>(w.ops), best.evaluate))
+           << ",\"closureMs\":" << number(best.closures)
+           << ",\"closureOpsPerSec\":" << number(perSecond(static_cast<double>(w.ops), best.closures))
+           << ",\"vmMs\":" << number(best.vm)
+           << ",\"vmOpsPerSec\":" << number(perSecond(static_cast<double>(w.ops), best.vm))
+           << ",\"ssaInstructions\":" << ssaChunkSize
+           << ",\"ssaMs\":" << number(best.ssa)
+           << ",\"ssaOpsPerSec\":" << number(perSecond(static_cast<double>(w.ops), best.ssa))
+           << ",\"arenaBytes\":" << arenaBytes
+           << ",\"peakHeapKb\":" << (heapPeak - heapBefore) / 1024
+           << "}\n";
+    report.flush();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int scale = 1;
+    int repeat = 3;
+    bool optimize = false;
+    std::string only;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scale = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--only") == 0 && i + 1 < argc) only = argv[++i];
+        else if (std::strcmp(argv[i], "--optimize") == 0) optimize = true;
+    }
+    if (scale < 1) scale = 1;
+    if (repeat < 1) repeat = 1;
+
+    Workload (*const generators[])(int) = {
+        nestedExpressions, countedLoop, branchyLoop, manyIdentifiers, largeStrings
+    };
+
+    for (Workload (*generate)(int) : generators) {
+        Workload w = generate(scale);
+        if (!only.empty() && w.name != only) continue;
+        try {
+            runWorkload(w, repeat, optimize, std::cout);
+        } catch (const std::exception& e) {
+            std::cout << "{\"workload\":" << jsonQuote(w.name)
+                      << ",\"error\":" << jsonQuote(e.what()) << "}\n";
+            return 1;
+        }
+    }
+    std::cout << "{\"peakRssKb\":" << peakResidentKb() << "}\n";
+    return 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "arena.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Stack machine instruction set. Every instruction is a fixed 8-byte
+// (opcode, operand) pair so the program is one flat, cache-friendly array.
+enum class OpCode : uint8_t {
+    PUSH,          // push arg
+    LOAD,          // push variable[arg]
+    STORE,         // variable[arg] = top (value stays on the stack)
+    POP,
+
+    // Arithmetic (both ASCII and Bangla forms lower to these)
+    ADD, SUB, MUL,
+    DIV,           // stack: [.., right, left] -> left / right
+    CHECK_DIVISOR, // throw "Division by zero" if the top is 0 (it stays)
+
+    // Comparison
+    EQ, NEQ, LT, GT,
+
+    // Control flow
+    JUMP,          // pc = arg
+    LOOP,          // pc = arg, a loop back-edge (counted against the step limit)
+    JUMP_IF_FALSE, // pop, pc = arg if zero
+
+    // Counted প্রতিবার loops, operands in loops[arg]
+    FOR_TEST,      // pc = exit unless variable <compare> bound
+    FOR_NEXT,      // variable += step, then a back-edge to FOR_TEST
+
+    // Statements
+    PRINT,         // লেখ <number>
+    PRINT_STR,     // লেখ "strings[arg]"
+    VOWEL_CHECK,   // স্বরবর্ণচেক("strings[arg]")
+    FAIL,          // throw strings[arg]
+    HALT
+};
+
+// Net stack effect of each opcode. Used to size the VM stack up front and
+// by the JIT, which gives every stack position a fixed address.
+inline int stackEffect(OpCode op) {
+    switch (op) {
+        case OpCode::PUSH:
+        case OpCode::LOAD:
+        case OpCode::FAIL:  // never returns, but stands in for a value
+            return 1;
+        case OpCode::POP:
+        case OpCode::ADD: case OpCode::SUB:
+        case OpCode::MUL: case OpCode::DIV:
+        case OpCode::EQ: case OpCode::NEQ:
+        case OpCode::LT: case OpCode::GT:
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::PRINT:
+            return -1;
+        default:
+            return 0;
+    }
+}
+
+struct Instruction {
+    OpCode op;
+    int32_t arg;
+
+    Instruction(OpCode o, int32_t a = 0) : op(o), arg(a) {}
+};
+
+// Operands of one counted loop (see counted_loop.h)
+struct LoopSpec {
+    int32_t slot;      // induction variable
+    OpCode compare;    // EQ, NEQ, LT or GT
+    bool boundIsSlot;
+    int32_t bound;     // literal, or slot of a variable the loop never writes
+    int32_t step;
+    int32_t test;      // pc of the loop's FOR_TEST
+    int32_t exit;      // pc just past the loop
+};
+
+// Where one string of a chunk lives in its text
+struct StringEntry {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// What the VM and the JIT run: a Chunk in memory, or a compiled program
+// file mapped straight from disk (see program_file.h). Nothing here owns
+// memory.
+struct ChunkView {
+    const Instruction* code = nullptr;
+    uint32_t codeSize = 0;
+    const LoopSpec* loops = nullptr;
+    uint32_t loopCount = 0;
+    const char* text = nullptr;
+    const StringEntry* strings = nullptr;
+    uint32_t stringCount = 0;
+    const StringEntry* names = nullptr;
+    uint32_t nameCount = 0;
+    uint32_t slotCount = 0;  // nameCount, then the chunk's temporaries
+    int maxStack = 0;
+
+    StringRef string(int32_t index) const {
+        return StringRef(text + strings[index].offset, strings[index].size);
+    }
+    std::string name(size_t slot) const {
+        return std::string(text + names[slot].offset, names[slot].size);
+    }
+};
+
+// Strings and slot names share one byte buffer, so a chunk has the same
+// shape in memory as in a program file
+struct Chunk {
+    std::vector<Instruction> code;
+    std::string text;                  // bytes of every string and name
+    std::vector<StringEntry> strings;  // string literals and error messages
+    std::vector<StringEntry> names;    // variable name of each slot used by LOAD/STORE
+    std::vector<LoopSpec> loops;       // used by FOR_TEST/FOR_NEXT
+    uint32_t temporaries = 0;          // unnamed slots after the named ones
+    int maxStack = 0;
+
+    int addString(const std::string& str) {
+        strings.push_back(StringEntry{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(str.size())});
+        text += str;
+        return static_cast<int>(strings.size() - 1);
+    }
+    void addName(const std::string& name) {
+        names.push_back(StringEntry{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(name.size())});
+        text += name;
+    }
+
+    ChunkView view() const {
+        ChunkView v;
+        v.code = code.data();
+        v.codeSize = static_cast<uint32_t>(code.size());
+        v.loops = loops.data();
+        v.loopCount = static_cast<uint32_t>(loops.size());
+        v.text = text.data();
+        v.strings = strings.data();
+        v.stringCount = static_cast<uint32_t>(strings.size());
+        v.names = names.data();
+        v.nameCount = static_cast<uint32_t>(names.size());
+        v.slotCount = v.nameCount + temporaries;
+        v.maxStack = maxStack;
+        return v;
+    }
+};
@@ -0,0 +1,616 @@
+#include "closure_engine.h"
+#include "bangla_text.h"
+#include "counted_loop.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+namespace {
+
+// What closures touch while the program runs
+struct Runtime {
+    int* slots;
+    ExecutionBudget* budget;
+    OutputSink* out;
+};
+
+struct Closure;
+typedef int (*Code)(const Closure& self, Runtime& rt);
+
+// One compiled node. What the fields hold depends on code: a, b and c are
+// slots or constants, first and second operands or parts of a statement,
+// body the count statements of a block or loop (text the count bytes a
+// লেখ prints). Kept to 48 bytes: a large program builds one per node.
+struct Closure {
+    Code code;
+    int a, b, c;
+    uint32_t count;
+    const Closure* first;
+    const Closure* second;
+    union {
+        const Closure* const* body;
+        const char* text;
+    };
+};
+
+inline int call(const Closure* closure, Runtime& rt) {
+    return closure->code(*closure, rt);
+}
+
+inline void runBody(const Closure& self, Runtime& rt) {
+    for (uint32_t i = 0; i < self.count; i++) call(self.body[i], rt);
+}
+
+struct Add { static int apply(int l, int r) { return l + r; } };
+struct Sub { static int apply(int l, int r) { return l - r; } };
+struct Mul { static int apply(int l, int r) { return l * r; } };
+
+struct Equal { static bool test(int l, int r) { return l == r; } };
+struct NotEqual { static bool test(int l, int r) { return l != r; } };
+struct Less { static bool test(int l, int r) { return l < r; } };
+struct Greater { static bool test(int l, int r) { return l > r; } };
+
+// Values
+
+int constant(const Closure& self, Runtime&) { return self.a; }
+int load(const Closure& self, Runtime& rt) { return rt.slots[self.a]; }
+
+template <class Op> int binary(const Closure& self, Runtime& rt) {
+    int left = call(self.first, rt);
+    return Op::apply(left, call(self.second, rt));
+}
+template <class Op> int slotConst(const Closure& self, Runtime& rt) { return Op::apply(rt.slots[self.a], self.b); }
+template <class Op> int constSlot(const Closure& self, Runtime& rt) { return Op::apply(self.a, rt.slots[self.b]); }
+template <class Op> int slotSlot(const Closure& self, Runtime& rt) { return Op::apply(rt.slots[self.a], rt.slots[self.b]); }
+template <class Op> int anyConst(const Closure& self, Runtime& rt) { return Op::apply(call(self.first, rt), self.b); }
+template <class Op> int constAny(const Closure& self, Runtime& rt) { return Op::apply(self.a, call(self.second, rt)); }
+
+// The divisor is evaluated and checked before the dividend
+int divide(const Closure& self, Runtime& rt) {
+    int right = call(self.second, rt);
+    if (right == 0) throw std::runtime_error("Division by zero");
+    int left = call(self.first, rt);
+    if (right == -1 && left == INT_MIN) throw std::runtime_error("Integer overflow");
+    return left / right;
+}
+int divideSlotSlot(const Closure& self, Runtime& rt) {
+    int right = rt.slots[self.b];
+    if (right == 0) throw std::runtime_error("Division by zero");
+    int left = rt.slots[self.a];
+    if (right == -1 && left == INT_MIN) throw std::runtime_error("Integer overflow");
+    return left / right;
+}
+int divideByConst(const Closure& self, Runtime& rt) { return call(self.first, rt) / self.b; }  // b is not 0 or -1
+int divideSlotConst(const Closure& self, Runtime& rt) { return rt.slots[self.a] / self.b; }
+
+int assign(const Closure& self, Runtime& rt) {
+    int value = call(self.first, rt);
+    rt.slots[self.a] = value;
+    return value;
+}
+int assignConst(const Closure& self, Runtime& rt) {
+    rt.slots[self.a] = self.b;
+    return self.b;
+}
+// slot a = slot b <op> c, as in i = i + 1
+template <class Op> int assignSlotConst(const Closure& self, Runtime& rt) {
+    int value = Op::apply(rt.slots[self.b], self.c);
+    rt.slots[self.a] = value;
+    return value;
+}
+
+int unknownNode(const Closure&, Runtime&) {
+    throw std::runtime_error("Unknown node type");
+}
+
+// Conditions
+
+template <class Cmp> int compare(const Closure& self, Runtime& rt) {
+    int left = call(self.first, rt);
+    return Cmp::test(left, call(self.second, rt));
+}
+template <class Cmp> int compareSlotConst(const Closure& self, Runtime& rt) { return Cmp::test(rt.slots[self.a], self.b); }
+template <class Cmp> int compareSlotSlot(const Closure& self, Runtime& rt) {
+    return Cmp::test(rt.slots[self.a], rt.slots[self.b]);
+}
+
+// A condition that is not a comparison: both sides run, then it is false
+int neither(const Closure& self, Runtime& rt) {
+    call(self.first, rt);
+    call(self.second, rt);
+    return 0;
+}
+
+// Statements
+
+int print(const Closure& self, Runtime& rt) {
+    int value = call(self.first, rt);
+    rt.budget->chargeMemory(sizeof("লেখ: ") + decimalLength(value));
+    printNumberLine(*rt.out, value);
+    return 0;
+}
+int printText(const Closure& self, Runtime& rt) {
+    rt.budget->chargeMemory(sizeof("লেখ: ") + self.count);
+    printTextLine(*rt.out, self.text, self.count);
+    return 0;
+}
+int vowelCheck(const Closure& self, Runtime& rt) {  // a: whether the text has a vowel
+    rt.budget->chargeMemory(sizeof("স্বরবর্ণ আছে: হ্যাঁ"));
+    printVowelLine(*rt.out, self.a != 0);
+    return self.a;
+}
+
+int block(const Closure& self, Runtime& rt) {
+    runBody(self, rt);
+    return 0;
+}
+
+// body: the else branch, empty when there is none
+int ifElse(const Closure& self, Runtime& rt) {
+    if (call(self.first, rt)) call(self.second, rt);
+    else runBody(self, rt);
+    return 0;
+}
+
+int whileLoop(const Closure& self, Runtime& rt) {
+    while (call(self.first, rt)) {
+        runBody(self, rt);
+        rt.budget->onBackEdge();
+    }
+    return 0;
+}
+
+// first: init, second: condition (either may be missing); the increment
+// is the last statement of body
+int forLoop(const Closure& self, Runtime& rt) {
+    if (self.first) call(self.first, rt);
+    while (self.second && call(self.second, rt)) {
+        runBody(self, rt);
+        rt.budget->onBackEdge();
+    }
+    return 0;
+}
+
+// A counted প্রতিবার (see counted_loop.h): a is the variable, b the bound
+// (a slot when BoundIsSlot), c the step
+template <class Cmp, bool BoundIsSlot> int countedLoop(const Closure& self, Runtime& rt) {
+    if (self.first) call(self.first, rt);
+    int& var = rt.slots[self.a];
+    int bound = BoundIsSlot ? rt.slots[self.b] : self.b;
+    int i = var;
+    while (Cmp::test(i, bound)) {
+        runBody(self, rt);
+        i = countedLoopStep(i, self.c);
+        var = i;
+        rt.budget->onBackEdge();
+    }
+    return 0;
+}
+
+template <bool BoundIsSlot> Code countedLoopFor(TokenType compare) {
+    switch (compare) {
+        case TokenType::EQ: return countedLoop<Equal, BoundIsSlot>;
+        case TokenType::NEQ: return countedLoop<NotEqual, BoundIsSlot>;
+        case TokenType::LT: return countedLoop<Less, BoundIsSlot>;
+        default: return countedLoop<Greater, BoundIsSlot>;
+    }
+}
+
+bool isArithmetic(TokenType type) {
+    switch (type) {
+        case TokenType::PLUS: case TokenType::JOG:
+        case TokenType::MINUS: case TokenType::BIYOG:
+        case TokenType::MUL: case TokenType::GUN:
+        case TokenType::DIV: case TokenType::BHAG:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isComparison(TokenType type) {
+    return type == TokenType::EQ || type == TokenType::NEQ || type == TokenType::LT || type == TokenType::GT;
+}
+
+// Operands that evaluate to a value known before the run: numbers,
+// strings (their length), text built-ins and missing operands (0)
+bool literal(const ASTNode* node, int& value) {
+    if (!node) {
+        value = 0;
+        return true;
+    }
+    switch (node->type) {
+        case TokenType::NUM:
+            value = node->value;
+            return true;
+        case TokenType::STRING:
+            value = static_cast<int>(node->text.length());
+            return true;
+        case TokenType::BORNO:
+            value = runTextQuery(node->value, node->left->text.data, node->left->text.length());
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool variable(const ASTNode* node, int& slot) {
+    if (!node || node->type != TokenType::IDENTIFIER) return false;
+    slot = node->slot;
+    return true;
+}
+
+// Turns a program into closures. Statements nest at most MAX_NESTING deep
+// and are compiled recursively; expressions may nest any depth, so they
+// are compiled from a work list and only their height is checked.
+class ClosureBuilder {
+    Arena& arena;
+    bool deep = false;
+
+    // Work list of expression(): a node, or one whose operands are built
+    struct Pending {
+        ASTNode* node;
+        bool operandsDone;
+    };
+    std::vector<Pending> pending;
+    std::vector<const Closure*> built;  // operands waiting for their operator;
+                                        // nullptr for numbers and variables,
+                                        // which most operators read directly
+    std::vector<int> heights;           // of the closures in built
+
+    Closure* make(Code code) {
+        Closure* closure = arena.make<Closure>();
+        closure->code = code;
+        return closure;
+    }
+
+    const Closure* constantOf(int value) {
+        Closure* closure = make(constant);
+        closure->a = value;
+        return closure;
+    }
+
+    const Closure* leaf(ASTNode* node);
+    const Closure* operand(const Closure* built, ASTNode* node) { return built ? built : leaf(node); }
+    template <class Op> const Closure* arithmeticFor(Closure* closure, ASTNode* node, const Closure* left,
+                                                     const Closure* right);
+    const Closure* arithmetic(ASTNode* node, const Closure* left, const Closure* right);
+    const Closure* assignment(ASTNode* node, const Closure* value);
+    const Closure* statements(const NodeList& list, Closure* owner, const Closure* last = nullptr);
+
+public:
+    explicit ClosureBuilder(Arena& a) : arena(a) {}
+
+    // True once an expression was too deep for closures
+    bool tooDeep() const { return deep; }
+
+    const Closure* expression(ASTNode* root);
+    const Closure* condition(ASTNode* node);
+    const Closure* statement(ASTNode* node);
+};
+
+const Closure* ClosureBuilder::leaf(ASTNode* node) {
+    int value;
+    if (literal(node, value)) return constantOf(value);
+    switch (node->type) {
+        case TokenType::IDENTIFIER:
+            {
+                Closure* closure = make(load);
+                closure->a = node->slot;
+                return closure;
+            }
+        case TokenType::EQ: case TokenType::NEQ:
+        case TokenType::LT: case TokenType::GT:
+            // A comparison only has a value as a condition
+            return make(unknownNode);
+        default:
+            // Expressions contain no statements; anything else fails as
+            // the Evaluator would
+            return statement(node);
+    }
+}
+
+// Picks the closure for left <op> right from what the operands are
+template <class Op>
+const Closure* ClosureBuilder::arithmeticFor(Closure* closure, ASTNode* node, const Closure* left,
+                                             const Closure* right) {
+    int l = 0, r = 0;
+    if (variable(node->left, l) && literal(node->right, r)) {
+        closure->code = slotConst<Op>;
+    } else if (literal(node->left, l) && variable(node->right, r)) {
+        closure->code = constSlot<Op>;
+    } else if (variable(node->left, l) && variable(node->right, r)) {
+        closure->code = slotSlot<Op>;
+    } else if (literal(node->right, r)) {
+        closure->code = anyConst<Op>;
+        closure->first = operand(left, node->left);
+    } else if (literal(node->left, l)) {
+        closure->code = constAny<Op>;
+        closure->second = operand(right, node->right);
+    } else {
+        closure->code = binary<Op>;
+        closure->first = operand(left, node->left);
+        closure->second = operand(right, node->right);
+    }
+    closure->a = l;
+    closure->b = r;
+    return closure;
+}
+
+const Closure* ClosureBuilder::arithmetic(ASTNode* node, const Closure* left, const Closure* right) {
+    Closure* closure = make(nullptr);
+    switch (node->type) {
+        case TokenType::PLUS: case TokenType::JOG:
+            return arithmeticFor<Add>(closure, node, left, right);
+        case TokenType::MINUS: case TokenType::BIYOG:
+            return arithmeticFor<Sub>(closure, node, left, right);
+        case TokenType::MUL: case TokenType::GUN:
+            return arithmeticFor<Mul>(closure, node, left, right);
+        default:
+            break;
+    }
+
+    int l, r;
+    if (literal(node->right, r) && r != 0 && r != -1) {
+        closure->b = r;
+        if (variable(node->left, l)) {
+            closure->code = divideSlotConst;
+            closure->a = l;
+        } else {
+            closure->code = divideByConst;
+            closure->first = operand(left, node->left);
+        }
+    } else if (variable(node->left, l) && variable(node->right, r)) {
+        closure->code = divideSlotSlot;
+        closure->a = l;
+        closure->b = r;
+    } else {
+        closure->code = divide;
+        closure->first = operand(left, node->left);
+        closure->second = operand(right, node->right);
+    }
+    return closure;
+}
+
+const Closure* ClosureBuilder::assignment(ASTNode* node, const Closure* value) {
+    Closure* closure = make(assign);
+    closure->a = node->slot;
+
+    const ASTNode* sum = node->right;
+    int k, source;
+    if (literal(sum, k)) {
+        closure->code = assignConst;
+        closure->b = k;
+        return closure;
+    }
+
+    // slot = variable <op> constant (or constant + / * variable)
+    Code fused = nullptr;
+    if (variable(sum->left, source) && literal(sum->right, k)) {
+        switch (sum->type) {
+            case TokenType::PLUS: case TokenType::JOG: fused = assignSlotConst<Add>; break;
+            case TokenType::MINUS: case TokenType::BIYOG: fused = assignSlotConst<Sub>; break;
+            case TokenType::MUL: case TokenType::GUN: fused = assignSlotConst<Mul>; break;
+            default: break;
+        }
+    } else if (literal(sum->left, k) && variable(sum->right, source)) {
+        switch (sum->type) {
+            case TokenType::PLUS: case TokenType::JOG: fused = assignSlotConst<Add>; break;
+            case TokenType::MUL: case TokenType::GUN: fused = assignSlotConst<Mul>; break;
+            default: break;
+        }
+    }
+    if (fused) {
+        closure->code = fused;
+        closure->b = source;
+        closure->c = k;
+    } else {
+        closure->first = operand(value, node->right);
+    }
+    return closure;
+}
+
+const Closure* ClosureBuilder::expression(ASTNode* root) {
+    // Reentrant: a statement found inside an expression builds its own
+    // expressions above this one's entries
+    const size_t pendingBase = pending.size(), builtBase = built.size();
+    pending.push_back(Pending{root, false});
+
+    while (pending.size() > pendingBase) {
+        Pending item = pending.back();
+        pending.pop_back();
+        ASTNode* node = item.node;
+        bool binary = node && isArithmetic(node->type);
+        bool unary = node && node->type == TokenType::ASSIGN;
+
+        if (!item.operandsDone && (binary || unary)) {
+            pending.push_back(Pending{node, true});
+            pending.push_back(Pending{node->right, false});
+            if (binary) pending.push_back(Pending{node->left, false});
+            continue;
+        }
+
+        const Closure* closure;
+        int height = 1;
+        if (binary) {
+            const Closure* right = built.back();
+            const Closure* left = built[built.size() - 2];
+            height += std::max(heights.back(), heights[heights.size() - 2]);
+            built.resize(built.size() - 2);
+            heights.resize(heights.size() - 2);
+            closure = arithmetic(node, left, right);
+        } else if (unary) {
+            const Closure* value = built.back();
+            height += heights.back();
+            built.pop_back();
+            heights.pop_back();
+            closure = assignment(node, value);
+        } else {
+            int unused;
+            closure = literal(node, unused) || variable(node, unused) ? nullptr : leaf(node);
+        }
+        if (height > MAX_CLOSURE_DEPTH) deep = true;
+        built.push_back(closure);
+        heights.push_back(height);
+    }
+
+    const Closure* result = operand(built[builtBase], root);
+    built.resize(builtBase);
+    heights.resize(builtBase);
+    return result;
+}
+
+const Closure* ClosureBuilder::condition(ASTNode* node) {
+    if (!node) return constantOf(0);
+
+    Closure* closure = make(neither);
+    int l, r;
+    switch (node->type) {
+        case TokenType::EQ: closure->code = compare<Equal>; break;
+        case TokenType::NEQ: closure->code = compare<NotEqual>; break;
+        case TokenType::LT: closure->code = compare<Less>; break;
+        case TokenType::GT: closure->code = compare<Greater>; break;
+        default: break;
+    }
+    if (isComparison(node->type) && variable(node->left, l)) {
+        if (literal(node->right, r) || variable(node->right, r)) {
+            bool both = node->right && node->right->type == TokenType::IDENTIFIER;
+            switch (node->type) {
+                case TokenType::EQ: closure->code = both ? compareSlotSlot<Equal> : compareSlotConst<Equal>; break;
+                case TokenType::NEQ: closure->code = both ? compareSlotSlot<NotEqual> : compareSlotConst<NotEqual>; break;
+                case TokenType::LT: closure->code = both ? compareSlotSlot<Less> : compareSlotConst<Less>; break;
+                default: closure->code = both ? compareSlotSlot<Greater> : compareSlotConst<Greater>; break;
+            }
+            closure->a = l;
+            closure->b = r;
+            return closure;
+        }
+    }
+    closure->first = expression(node->left);
+    closure->second = expression(node->right);
+    return closure;
+}
+
+// Compiles list, followed by last if given, into owner's body
+const Closure* ClosureBuilder::statements(const NodeList& list, Closure* owner, const Closure* last) {
+    std::vector<const Closure*> compiled;
+    compiled.reserve(list.size() + 1);
+    for (ASTNode* child : list) compiled.push_back(statement(child));
+    if (last) compiled.push_back(last);
+    owner->body = arena.copyArray(compiled.data(), compiled.size());
+    owner->count = static_cast<uint32_t>(compiled.size());
+    return owner;
+}
+
+const Closure* ClosureBuilder::statement(ASTNode* node) {
+    if (!node) return constantOf(0);
+
+    switch (node->type) {
+        case TokenType::LEKHO:
+            {
+                if (node->left && node->left->type == TokenType::STRING) {
+                    Closure* closure = make(printText);
+                    closure->text = node->left->text.data;
+                    closure->count = static_cast<uint32_t>(node->left->text.length());
+                    return closure;
+                }
+                Closure* closure = make(print);
+                closure->first = expression(node->left);
+                return closure;
+            }
+
+        case TokenType::SHOROBORNO:
+            {
+                Closure* closure = make(vowelCheck);
+                closure->a = containsVowel(node->left->text.data, node->left->text.length()) ? 1 : 0;
+                return closure;
+            }
+
+        case TokenType::JODI:
+            {
+                Closure* closure = make(ifElse);
+                closure->first = condition(node->left);
+                Closure* then = make(block);
+                closure->second = node->right ? statements(node->right->children, then) : then;
+                return node->extra ? statements(node->extra->children, closure) : closure;
+            }
+
+        case TokenType::JOTOKKHON:
+            {
+                Closure* closure = make(whileLoop);
+                closure->first = condition(node->left);
+                return node->right ? statements(node->right->children, closure) : closure;
+            }
+
+        case TokenType::PROTIBAR:
+            {
+                Closure* closure = make(forLoop);
+                if (node->left) closure->first = statement(node->left);
+
+                CountedLoop shape;
+                const Closure* increment = nullptr;
+                if (matchCountedLoop(node, shape)) {
+                    closure->code = shape.boundIsSlot ? countedLoopFor<true>(shape.compare)
+                                                      : countedLoopFor<false>(shape.compare);
+                    closure->a = shape.slot;
+                    closure->b = shape.bound;
+                    closure->c = shape.step;
+                } else {
+                    if (node->right) closure->second = condition(node->right);
+                    if (node->extra) increment = statement(node->extra);
+                }
+                return statements(node->children, closure, increment);
+            }
+
+        case TokenType::LBRACE:
+            return statements(node->children, make(block));
+
+        default:
+            // An expression used as a statement
+            return expression(node);
+    }
+}
+
+}  // namespace
+
+void ClosureEngine::storeSlots(const Program& program) {
+    for (size_t i = 0; i < slots.size(); i++) {
+        variables[program.slotNames[i]] = slots[i];
+    }
+}
+
+bool ClosureEngine::run(const Program& program) {
+    Arena arena(16384);
+    ClosureBuilder builder(arena);
+    const Closure* root = builder.statement(program.root);
+    if (builder.tooDeep()) return false;
+
+    slots.assign(program.slotNames.size(), 0);
+    for (size_t i = 0; i < slots.size(); i++) {
+        auto it = variables.find(program.slotNames[i]);
+        if (it != variables.end()) slots[i] = it->second;
+    }
+    budget.start(limits);
+    budget.chargeMemory(slots.size() * sizeof(int));
+
+    Runtime rt = {slots.data(), &budget, out};
+    try {
+        call(root, rt);
+    } catch (...) {
+        storeSlots(program);
+        out->flush();
+        throw;
+    }
+    storeSlots(program);
+    out->flush();
+    return true;
+}
+
+void ClosureEngine::setVariable(const std::string& name, int value) {
+    variables[name] = value;
+}
+
+int ClosureEngine::getVariable(const std::string& name) {
+    auto it = variables.find(name);
+    return it == variables.end() ? 0 : it->second;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "parser.h"
+#include "exec_limits.h"
+#include "output.h"
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+// Expressions nested deeper than this are left to the Evaluator: closures
+// call their operands on the native stack
+const int MAX_CLOSURE_DEPTH = 512;
+
+// Closure-compiling engine, an alternative to the tree-walking Evaluator.
+// Before a run every node is turned once into a closure: a function
+// specialized for the node's operator and the shape of its operands
+// ("variable + constant", "variable < constant", a counted প্রতিবার
+// loop, ...) together with the slots and constants it needs. Running the
+// program is then one indirect call per closure, with no switch on the
+// node type and no telling ASCII operators from their Bangla forms.
+// Output, errors and limits are exactly the Evaluator's.
+//
+// run() returns false without executing anything when an expression nests
+// deeper than MAX_CLOSURE_DEPTH, so callers can fall back to the Evaluator.
+class ClosureEngine {
+    std::unordered_map<std::string, int> variables;
+    std::vector<int> slots;
+    OutputSink* out;
+    ExecutionLimits limits;
+    ExecutionBudget budget;
+
+    void storeSlots(const Program& program);
+
+public:
+    ClosureEngine() : out(&standardOutput()) {}
+    void setOutput(OutputSink& sink) { out = &sink; }
+    void setLimits(const ExecutionLimits& newLimits) { limits = newLimits; }
+
+    bool run(const Program& program);
+    void setVariable(const std::string& name, int value);
+    int getVariable(const std::string& name);
+};
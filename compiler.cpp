@@ -0,0 +1,282 @@
+#include "compiler.h"
+#include "counted_loop.h"
+#include "bangla_text.h"
+
+int Compiler::emit(OpCode op, int32_t arg) {
+    chunk.code.push_back(Instruction(op, arg));
+    depth += stackEffect(op);
+    if (depth > chunk.maxStack) chunk.maxStack = depth;
+    return here() - 1;
+}
+
+void Compiler::patch(int at, int target) {
+    chunk.code[at].arg = target;
+}
+
+int Compiler::stringSlot(const std::string& str) {
+    auto it = stringIndex.find(str);
+    if (it != stringIndex.end()) return it->second;
+    int slot = chunk.addString(str);
+    stringIndex[str] = slot;
+    return slot;
+}
+
+// Operands come off the work list before the operator that waits for
+// them, in the order the evaluator runs them, so deep expressions use no
+// native stack
+void Compiler::later(ASTNode* op, ASTNode* first, ASTNode* second) {
+    pending.push_back(Pending{op, true, false});
+    pending.push_back(Pending{second, false, false});
+    pending.push_back(Pending{first, false, false});
+}
+
+void Compiler::compileExpression(ASTNode* root) {
+    // Expressions contain no statements, so this never nests
+    pending.clear();
+    pending.push_back(Pending{root, false, false});
+
+    while (!pending.empty()) {
+        Pending item = pending.back();
+        pending.pop_back();
+        ASTNode* node = item.node;
+        if (!node) {
+            emit(OpCode::PUSH, 0);
+            continue;
+        }
+
+        switch (node->type) {
+            case TokenType::NUM:
+                emit(OpCode::PUSH, node->value);
+                break;
+
+            case TokenType::STRING:
+                // Strings evaluate to their length
+                emit(OpCode::PUSH, static_cast<int32_t>(node->text.length()));
+                break;
+
+            case TokenType::BORNO:
+                // The argument is a literal, so the answer is known now
+                emit(OpCode::PUSH, runTextQuery(node->value, node->left->text.data, node->left->text.length()));
+                break;
+
+            case TokenType::IDENTIFIER:
+                emit(OpCode::LOAD, node->slot);
+                break;
+
+            case TokenType::PLUS:
+            case TokenType::JOG:
+                if (item.operandsDone) emit(OpCode::ADD);
+                else later(node, node->left, node->right);
+                break;
+
+            case TokenType::MINUS:
+            case TokenType::BIYOG:
+                if (item.operandsDone) emit(OpCode::SUB);
+                else later(node, node->left, node->right);
+                break;
+
+            case TokenType::MUL:
+            case TokenType::GUN:
+                if (item.operandsDone) emit(OpCode::MUL);
+                else later(node, node->left, node->right);
+                break;
+
+            case TokenType::DIV:
+            case TokenType::BHAG:
+                // The evaluator computes the divisor and checks it for
+                // zero before it computes the dividend
+                if (item.operandsDone) {
+                    emit(OpCode::DIV);
+                } else if (item.divisorDone) {
+                    emit(OpCode::CHECK_DIVISOR);
+                    pending.push_back(Pending{node, true, false});
+                    pending.push_back(Pending{node->left, false, false});
+                } else {
+                    pending.push_back(Pending{node, false, true});
+                    pending.push_back(Pending{node->right, false, false});
+                }
+                break;
+
+            case TokenType::ASSIGN:
+                if (item.operandsDone) {
+                    emit(OpCode::STORE, node->slot);
+                } else {
+                    pending.push_back(Pending{node, true, false});
+                    pending.push_back(Pending{node->right, false, false});
+                }
+                break;
+
+            default:
+                // Comparisons (and anything else) are not values
+                emit(OpCode::FAIL, stringSlot("Unknown node type"));
+                break;
+        }
+    }
+}
+
+void Compiler::compileCondition(ASTNode* node) {
+    if (!node) {
+        emit(OpCode::PUSH, 0);
+        return;
+    }
+
+    switch (node->type) {
+        case TokenType::EQ:
+        case TokenType::NEQ:
+        case TokenType::LT:
+        case TokenType::GT:
+            compileExpression(node->left);
+            compileExpression(node->right);
+            emit(node->type == TokenType::EQ ? OpCode::EQ :
+                 node->type == TokenType::NEQ ? OpCode::NEQ :
+                 node->type == TokenType::LT ? OpCode::LT : OpCode::GT);
+            break;
+
+        default:
+            // Not a comparison: operands still run, the condition is false
+            if (node->left) {
+                compileExpression(node->left);
+                emit(OpCode::POP);
+            }
+            if (node->right) {
+                compileExpression(node->right);
+                emit(OpCode::POP);
+            }
+            emit(OpCode::PUSH, 0);
+            break;
+    }
+}
+
+void Compiler::compileBlock(ASTNode* node) {
+    if (!node) return;
+
+    for (ASTNode* child : node->children) {
+        compileStatement(child);
+    }
+}
+
+// Test and increment become one instruction each instead of a dozen
+void Compiler::compileCountedLoop(ASTNode* node, const CountedLoop& shape) {
+    LoopSpec spec;
+    spec.slot = shape.slot;
+    spec.compare = shape.compare == TokenType::EQ ? OpCode::EQ :
+                   shape.compare == TokenType::NEQ ? OpCode::NEQ :
+                   shape.compare == TokenType::LT ? OpCode::LT : OpCode::GT;
+    spec.boundIsSlot = shape.boundIsSlot;
+    spec.bound = shape.bound;
+    spec.step = shape.step;
+
+    int index = static_cast<int>(chunk.loops.size());
+    chunk.loops.push_back(spec);
+
+    int top = emit(OpCode::FOR_TEST, index);
+    for (ASTNode* child : node->children) {
+        compileStatement(child);
+    }
+    emit(OpCode::FOR_NEXT, index);
+
+    chunk.loops[index].test = top;
+    chunk.loops[index].exit = here();
+}
+
+void Compiler::compileStatement(ASTNode* node) {
+    if (!node) return;
+    if (statementOffsets) {
+        auto it = statementOffsets->find(node);
+        if (it != statementOffsets->end()) starts.push_back(StatementStart{here(), it->second});
+    }
+
+    switch (node->type) {
+        case TokenType::LEKHO:
+            if (node->left->type == TokenType::STRING) {
+                emit(OpCode::PRINT_STR, stringSlot(node->left->text.str()));
+            } else {
+                compileExpression(node->left);
+                emit(OpCode::PRINT);
+            }
+            break;
+
+        case TokenType::SHOROBORNO:
+            emit(OpCode::VOWEL_CHECK, stringSlot(node->left->text.str()));
+            break;
+
+        case TokenType::JODI: // যদি (if)
+            {
+                compileCondition(node->left);
+                int toElse = emit(OpCode::JUMP_IF_FALSE);
+                compileBlock(node->right);
+                if (node->extra) {
+                    int toEnd = emit(OpCode::JUMP);
+                    patch(toElse, here());
+                    compileBlock(node->extra);
+                    patch(toEnd, here());
+                } else {
+                    patch(toElse, here());
+                }
+                break;
+            }
+
+        case TokenType::JOTOKKHON: // যতক্ষণ (while)
+            {
+                int top = here();
+                compileCondition(node->left);
+                int toEnd = emit(OpCode::JUMP_IF_FALSE);
+                compileBlock(node->right);
+                emit(OpCode::LOOP, top);
+                patch(toEnd, here());
+                break;
+            }
+
+        case TokenType::PROTIBAR: // প্রতিবার (for)
+            {
+                if (node->left) {
+                    compileExpression(node->left);
+                    emit(OpCode::POP);
+                }
+                if (!node->right) break;  // no condition: body never runs
+
+                CountedLoop shape;
+                if (matchCountedLoop(node, shape)) {
+                    compileCountedLoop(node, shape);
+                    break;
+                }
+
+                int top = here();
+                compileCondition(node->right);
+                int toEnd = emit(OpCode::JUMP_IF_FALSE);
+                for (ASTNode* child : node->children) {
+                    compileStatement(child);
+                }
+                if (node->extra) {
+                    compileExpression(node->extra);
+                    emit(OpCode::POP);
+                }
+                emit(OpCode::LOOP, top);
+                patch(toEnd, here());
+                break;
+            }
+
+        case TokenType::LBRACE:
+            compileBlock(node);
+            break;
+
+        default:
+            // Expression statement
+            compileExpression(node);
+            emit(OpCode::POP);
+            break;
+    }
+}
+
+Chunk Compiler::compile(const Program& program) {
+    chunk = Chunk();
+    for (const std::string& name : program.slotNames) chunk.addName(name);
+    stringIndex.clear();
+    depth = 0;
+    pending.clear();
+    starts.clear();
+
+    compileStatement(program.root);
+    emit(OpCode::HALT);
+    return chunk;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "parser.h"
+#include "bytecode.h"
+#include "counted_loop.h"
+#include <unordered_map>
+#include <vector>
+
+// First instruction of a statement, and the statement's source offset
+struct StatementStart {
+    int32_t pc;
+    uint32_t offset;
+};
+
+// Lowers the AST produced by Parser::parseProgram into a flat Chunk.
+// The generated code mirrors Evaluator node for node, so running it on the
+// VM prints exactly what the tree-walking evaluator prints.
+class Compiler {
+    Chunk chunk;
+    std::unordered_map<std::string, int> stringIndex;
+    int depth = 0;
+
+    // Work list of compileExpression: a node, an operator whose operands
+    // have been compiled, or a division whose divisor has been
+    struct Pending {
+        ASTNode* node;
+        bool operandsDone;
+        bool divisorDone;
+    };
+    std::vector<Pending> pending;
+    const StatementOffsets* statementOffsets = nullptr;
+    std::vector<StatementStart> starts;
+
+    int emit(OpCode op, int32_t arg = 0);
+    void patch(int at, int target);
+    int here() const { return static_cast<int>(chunk.code.size()); }
+    int stringSlot(const std::string& str);
+
+    void later(ASTNode* op, ASTNode* first, ASTNode* second);
+    void compileExpression(ASTNode* root);
+    void compileCondition(ASTNode* node);
+    void compileStatement(ASTNode* node);
+    void compileBlock(ASTNode* node);
+    void compileCountedLoop(ASTNode* node, const CountedLoop& shape);
+
+public:
+    Chunk compile(const Program& program);
+
+    // With the parser's statement offsets, compile() also notes where each
+    // statement's code starts, in code order; nested statements starting
+    // at the same instruction are listed outermost first
+    void setStatementOffsets(const StatementOffsets* offsets) { statementOffsets = offsets; }
+    const std::vector<StatementStart>& statementStarts() const { return starts; }
+};
@@ -0,0 +1,99 @@
+#include "counted_loop.h"
+#include <vector>
+
+// Literal operand value; strings count as their length
+static bool literalValue(const ASTNode* node, int& value) {
+    if (!node) return false;
+    if (node->type == TokenType::NUM) {
+        value = node->value;
+        return true;
+    }
+    if (node->type == TokenType::STRING) {
+        value = static_cast<int>(node->text.length());
+        return true;
+    }
+    return false;
+}
+
+static bool isVariable(const ASTNode* node, int slot) {
+    return node && node->type == TokenType::IDENTIFIER && node->slot == slot;
+}
+
+// True if any assignment under root writes slot. Walks a work list, as
+// expressions can be nested any depth.
+static bool writesSlot(const ASTNode* root, int slot) {
+    std::vector<const ASTNode*> unvisited(1, root);
+    while (!unvisited.empty()) {
+        const ASTNode* node = unvisited.back();
+        unvisited.pop_back();
+        if (!node) continue;
+        if (node->type == TokenType::ASSIGN && node->slot == slot) return true;
+
+        unvisited.push_back(node->left);
+        unvisited.push_back(node->right);
+        unvisited.push_back(node->extra);
+        for (const ASTNode* child : node->children) unvisited.push_back(child);
+    }
+    return false;
+}
+
+bool matchCountedLoop(const ASTNode* loop, CountedLoop& shape) {
+    const ASTNode* condition = loop->right;
+    const ASTNode* increment = loop->extra;
+    if (!condition || !increment) return false;
+
+    // i <op> bound
+    switch (condition->type) {
+        case TokenType::EQ: case TokenType::NEQ:
+        case TokenType::LT: case TokenType::GT:
+            break;
+        default:
+            return false;
+    }
+    const ASTNode* var = condition->left;
+    if (!var || var->type != TokenType::IDENTIFIER) return false;
+    int slot = var->slot;
+
+    CountedLoop result;
+    result.slot = slot;
+    result.compare = condition->type;
+    if (condition->right && condition->right->type == TokenType::IDENTIFIER &&
+        condition->right->slot != slot) {
+        result.boundIsSlot = true;
+        result.bound = condition->right->slot;
+    } else if (!literalValue(condition->right, result.bound)) {
+        return false;
+    }
+
+    // i = i + c, i = c + i or i = i - c
+    if (increment->type != TokenType::ASSIGN || increment->slot != slot) return false;
+    const ASTNode* sum = increment->right;
+    if (!sum) return false;
+    int c;
+    switch (sum->type) {
+        case TokenType::PLUS:
+        case TokenType::JOG:
+            if (isVariable(sum->left, slot) && literalValue(sum->right, c)) result.step = c;
+            else if (literalValue(sum->left, c) && isVariable(sum->right, slot)) result.step = c;
+            else return false;
+            break;
+
+        case TokenType::MINUS:
+        case TokenType::BIYOG:
+            if (!isVariable(sum->left, slot) || !literalValue(sum->right, c)) return false;
+            result.step = static_cast<int>(0u - static_cast<unsigned int>(c));
+            break;
+
+        default:
+            return false;
+    }
+
+    // The body must leave both the variable and the bound alone
+    for (const ASTNode* child : loop->children) {
+        if (writesSlot(child, slot)) return false;
+        if (result.boundIsSlot && writesSlot(child, result.bound)) return false;
+    }
+
+    shape = result;
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "parser.h"
+
+// A প্রতিবার loop of the form
+//     প্রতিবার (<init>; i < bound; i = i + step) <body>
+// where the body never assigns i or the bound. The comparison can be any of
+// == != < >, the bound a literal or another variable, and the increment
+// i + c, c + i or i - c. Such loops can keep i out of the general
+// evaluation path: test it against the bound and bump it directly.
+struct CountedLoop {
+    int slot = -1;      // induction variable, -1 if the loop is not counted
+    TokenType compare = TokenType::LT;
+    bool boundIsSlot = false;
+    int bound = 0;      // literal value, or the slot of the bound variable
+    int step = 0;       // added (with wrap-around) after every iteration
+};
+
+// Fills shape and returns true if loop (a PROTIBAR node) is counted
+bool matchCountedLoop(const ASTNode* loop, CountedLoop& shape);
+
+// i <compare> bound, as Evaluator would compute it
+inline bool countedLoopTest(TokenType compare, int i, int bound) {
+    switch (compare) {
+        case TokenType::EQ: return i == bound;
+        case TokenType::NEQ: return i != bound;
+        case TokenType::LT: return i < bound;
+        default: return i > bound;
+    }
+}
+
+inline int countedLoopStep(int i, int step) {
+    return static_cast<int>(static_cast<unsigned int>(i) + static_cast<unsigned int>(step));
+}
@@ -0,0 +1,231 @@
+#include "debugger.h"
+#include "parser.h"
+#include "compiler.h"
+#include "bangla_text.h"
+#include "counted_loop.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+std::shared_ptr<const DebugProgram> compileForDebugging(const std::string& source,
+                                                        std::vector<Diagnostic>& diagnostics) {
+    Lexer lexer(source);
+    std::vector<Token> tokens;
+    try {
+        tokens = lexer.tokenize();
+    } catch (const SyntaxError& e) {
+        diagnostics.push_back(e.diagnostic);
+        return nullptr;
+    }
+
+    size_t reported = diagnostics.size();
+    StatementOffsets offsets;
+    Parser parser(tokens, lexer);
+    parser.setDiagnostics(&diagnostics);
+    parser.setStatementOffsets(&offsets);
+    Program program = parser.parseProgram();
+    if (diagnostics.size() != reported) return nullptr;
+
+    std::shared_ptr<DebugProgram> compiled = std::make_shared<DebugProgram>();
+    Compiler compiler;
+    compiler.setStatementOffsets(&offsets);
+    compiled->chunk = compiler.compile(program);
+    compiled->statementAt.assign(compiled->chunk.code.size(), -1);
+    for (const StatementStart& start : compiler.statementStarts()) {
+        SourcePosition at = lexer.position(start.offset);
+        compiled->statementAt[start.pc] = static_cast<int32_t>(compiled->statements.size());
+        compiled->statements.push_back(DebugProgram::Statement{start.pc, start.offset, at.line, at.column});
+    }
+    return compiled;
+}
+
+DebugSession::DebugSession(std::shared_ptr<const DebugProgram> compiled, const ExecutionLimits& limits)
+    : program(std::move(compiled)), slots(program->chunk.view().slotCount, 0) {
+    budget.start(limits);
+    budget.chargeMemory(program->chunk.names.size() * sizeof(int));
+}
+
+void DebugSession::setBreakpoints(const std::vector<uint32_t>& lines) {
+    breakpoints.clear();
+    for (uint32_t line : lines) {
+        const DebugProgram::Statement* first = nullptr;
+        for (const DebugProgram::Statement& statement : program->statements) {
+            if (statement.line == line && (!first || statement.offset < first->offset)) first = &statement;
+        }
+        if (first) breakpoints.push_back(first->pc);
+    }
+    std::sort(breakpoints.begin(), breakpoints.end());
+    breakpoints.erase(std::unique(breakpoints.begin(), breakpoints.end()), breakpoints.end());
+}
+
+const DebugProgram::Statement* DebugSession::location() const {
+    return done || current < 0 ? nullptr : &program->statements[current];
+}
+
+std::vector<std::pair<std::string, int>> DebugSession::variables() const {
+    ChunkView chunk = program->chunk.view();
+    std::vector<std::pair<std::string, int>> values;
+    for (size_t i = 0; i < chunk.nameCount; i++) values.push_back(std::make_pair(chunk.name(i), slots[i]));
+    return values;
+}
+
+// The VM's loop, instruction for instruction, plus the checks that stop it.
+// Statement starts and output are only ever at an empty operand stack, so
+// the stack does not outlive a resume.
+StopReason DebugSession::resume(OutputSink& out, const StopConditions& stop) {
+    if (done) return StopReason::FINISHED;
+
+    ChunkView chunk = program->chunk.view();
+    const int32_t* statementAt = program->statementAt.data();
+    std::vector<int> stack(chunk.maxStack + 1);
+    int* const base = stack.data();
+    int* sp = base;
+    int* vars = slots.data();
+    const Instruction* code = chunk.code;
+    const LoopSpec* loops = chunk.loops;
+    uint64_t reached = 0;
+    budget.resume();
+
+    try {
+        for (;;) {
+            int32_t statement = statementAt[pc];
+            if (statement >= 0) {
+                if (checked) {
+                    checked = false;
+                } else if (sp == base) {
+                    current = statement;
+                    bool breakpoint = std::binary_search(breakpoints.begin(), breakpoints.end(), pc);
+                    bool stepped = stop.statements && ++reached == stop.statements;
+                    if (breakpoint || stepped) {
+                        checked = true;
+                        out.flush();
+                        return breakpoint ? StopReason::BREAKPOINT : StopReason::STEP;
+                    }
+                }
+            }
+
+            const Instruction& ins = code[pc++];
+            switch (ins.op) {
+                case OpCode::PUSH:
+                    *sp++ = ins.arg;
+                    break;
+
+                case OpCode::LOAD:
+                    *sp++ = vars[ins.arg];
+                    break;
+
+                case OpCode::STORE:
+                    vars[ins.arg] = sp[-1];
+                    break;
+
+                case OpCode::POP:
+                    sp--;
+                    break;
+
+                case OpCode::ADD: sp--; sp[-1] = sp[-1] + sp[0]; break;
+                case OpCode::SUB: sp--; sp[-1] = sp[-1] - sp[0]; break;
+                case OpCode::MUL: sp--; sp[-1] = sp[-1] * sp[0]; break;
+
+                case OpCode::DIV:
+                    {
+                        int left = *--sp;
+                        int right = sp[-1];
+                        if (right == 0) throw std::runtime_error("Division by zero");
+                        if (right == -1 && left == INT_MIN) throw std::runtime_error("Integer overflow");
+                        sp[-1] = left / right;
+                        break;
+                    }
+
+                case OpCode::CHECK_DIVISOR:
+                    if (sp[-1] == 0) throw std::runtime_error("Division by zero");
+                    break;
+
+                case OpCode::EQ: sp--; sp[-1] = sp[-1] == sp[0]; break;
+                case OpCode::NEQ: sp--; sp[-1] = sp[-1] != sp[0]; break;
+                case OpCode::LT: sp--; sp[-1] = sp[-1] < sp[0]; break;
+                case OpCode::GT: sp--; sp[-1] = sp[-1] > sp[0]; break;
+
+                case OpCode::JUMP:
+                    pc = ins.arg;
+                    break;
+
+                case OpCode::LOOP:
+                    budget.onBackEdge();
+                    pc = ins.arg;
+                    break;
+
+                case OpCode::JUMP_IF_FALSE:
+                    if (!*--sp) pc = ins.arg;
+                    break;
+
+                case OpCode::FOR_TEST:
+                    {
+                        const LoopSpec& loop = loops[ins.arg];
+                        int bound = loop.boundIsSlot ? vars[loop.bound] : loop.bound;
+                        int i = vars[loop.slot];
+                        bool more;
+                        switch (loop.compare) {
+                            case OpCode::EQ: more = i == bound; break;
+                            case OpCode::NEQ: more = i != bound; break;
+                            case OpCode::LT: more = i < bound; break;
+                            default: more = i > bound; break;
+                        }
+                        if (!more) pc = loop.exit;
+                        break;
+                    }
+
+                case OpCode::FOR_NEXT:
+                    {
+                        const LoopSpec& loop = loops[ins.arg];
+                        vars[loop.slot] = countedLoopStep(vars[loop.slot], loop.step);
+                        budget.onBackEdge();
+                        pc = loop.test;
+                        break;
+                    }
+
+                case OpCode::PRINT:
+                    {
+                        int val = *--sp;
+                        budget.chargeMemory(sizeof("লেখ: ") + decimalLength(val));
+                        printNumberLine(out, val);
+                        break;
+                    }
+
+                case OpCode::PRINT_STR:
+                    {
+                        StringRef text = chunk.string(ins.arg);
+                        budget.chargeMemory(sizeof("লেখ: ") + text.size);
+                        printTextLine(out, text.data, text.size);
+                        break;
+                    }
+
+                case OpCode::VOWEL_CHECK:
+                    {
+                        StringRef text = chunk.string(ins.arg);
+                        bool hasVowel = containsVowel(text.data, text.size);
+                        budget.chargeMemory(sizeof("স্বরবর্ণ আছে: হ্যাঁ"));
+                        printVowelLine(out, hasVowel);
+                        break;
+                    }
+
+                case OpCode::FAIL:
+                    throw std::runtime_error(chunk.string(ins.arg).str());
+
+                case OpCode::HALT:
+                    done = true;
+                    out.flush();
+                    return StopReason::FINISHED;
+            }
+
+            if (stop.afterOutput && sp == base &&
+                (ins.op == OpCode::PRINT || ins.op == OpCode::PRINT_STR || ins.op == OpCode::VOWEL_CHECK)) {
+                out.flush();
+                return StopReason::OUTPUT;
+            }
+        }
+    } catch (...) {
+        done = true;
+        out.flush();
+        throw;
+    }
+}
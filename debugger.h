@@ -0,0 +1,85 @@
+#pragma once
+#include "bytecode.h"
+#include "exec_limits.h"
+#include "lexer.h"
+#include "output.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Step debugging for many users at once. A program is compiled once into
+// a DebugProgram, which any number of sessions share, and a DebugSession
+// runs it on its own copy of the VM's loop that can stop and carry on
+// later: before a statement (after so many statements, or at a breakpoint
+// line) or right after a লেখ or স্বরবর্ণচেক.
+//
+// The operand stack is empty at every one of those points, so nothing of
+// the native stack or the interpreter has to be kept: a paused session is
+// an instruction index, its variables and its limits, a few hundred bytes
+// in all. Any number of them can wait on one thread, each resumed when
+// its user acts.
+
+// A program compiled without the AST optimizer, so every statement keeps
+// code of its own, with where each statement's code starts
+struct DebugProgram {
+    struct Statement {
+        int32_t pc;       // first instruction
+        uint32_t offset;  // in bytes
+        uint32_t line;    // from 1
+        uint32_t column;  // from 1, in code points
+    };
+
+    Chunk chunk;
+    std::vector<Statement> statements;  // in code order
+    std::vector<int32_t> statementAt;   // by pc: innermost statement starting there, or -1
+};
+
+// Returns null, with every syntax error in diagnostics, if source does
+// not parse
+std::shared_ptr<const DebugProgram> compileForDebugging(const std::string& source,
+                                                        std::vector<Diagnostic>& diagnostics);
+
+// What ends one DebugSession::resume besides breakpoints and the end
+struct StopConditions {
+    uint64_t statements = 0;   // stop before the Nth statement reached; 0 for no limit
+    bool afterOutput = false;  // stop after each লেখ and স্বরবর্ণচেক
+};
+
+enum class StopReason { STEP, BREAKPOINT, OUTPUT, FINISHED };
+
+class DebugSession {
+    std::shared_ptr<const DebugProgram> program;
+    std::vector<int> slots;
+    std::vector<int32_t> breakpoints;  // pcs, sorted
+    ExecutionBudget budget;
+    int32_t pc = 0;
+    int32_t current = -1;  // statement last reached
+    bool checked = false;  // the statement at pc was stopped at, so it runs now
+    bool done = false;
+
+public:
+    // Starts paused before the first statement, with fresh variables.
+    // limits apply to the whole run: the steps and memory of every resume
+    // add up, and the time limit applies to each resume on its own.
+    DebugSession(std::shared_ptr<const DebugProgram> compiled, const ExecutionLimits& limits);
+
+    // Stops before the first statement starting on each of these lines,
+    // every time it is reached, replacing the previous breakpoints. Lines
+    // with no statement starting on them are ignored.
+    void setBreakpoints(const std::vector<uint32_t>& lines);
+
+    // Runs until a stop condition, a breakpoint or the end, writing what
+    // the program prints to out. Throws what the VM would, a runtime error
+    // or LimitExceeded, after which the session is finished.
+    StopReason resume(OutputSink& out, const StopConditions& stop);
+
+    bool finished() const { return done; }
+
+    // Statement about to run, or running when stopped after output; null
+    // before the first and once finished
+    const DebugProgram::Statement* location() const;
+
+    // Every variable with its current value, in slot order
+    std::vector<std::pair<std::string, int>> variables() const;
+};
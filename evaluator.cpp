@@ -1,30 +1,23 @@
 #include "evaluator.h"
-#include <iostream>
+#include "bangla_text.h"
+#include "profiler.h"
 #include <algorithm>
+#include <climits>
 #include <stdexcept>
 
 bool Evaluator::isBanglaVowel(const std::string& str) {
-    // Bangla vowels in UTF-8
-    std::vector<std::string> banglaVowels = {
-        "অ", "আ", "ই", "ঈ", "উ", "ঊ", 
-        "ঋ", "এ", "ঐ", "ও", "ঔ"
-    };
-    
-    for (const auto& vowel : banglaVowels) {
-        if (str.find(vowel) != std::string::npos) {
-            return true;
-        }
-    }
-    return false;
+    // Any of অ আ ই ঈ উ ঊ ঋ এ ঐ ও ঔ, in one pass
+    return containsVowel(str.data(), str.size());
 }
 
+template <bool Profiling>
 bool Evaluator::evaluateCondition(ASTNode* node) {
     if (!node) return false;
     
-    int leftVal = evaluate(node->left);
-    int rightVal = evaluate(node->right);
+    int leftVal = visit<Profiling>(node->left);
+    int rightVal = visit<Profiling>(node->right);
     
-    switch (node->token.type) {
+    switch (node->type) {
         case TokenType::EQ: return leftVal == rightVal;
         case TokenType::NEQ: return leftVal != rightVal;
         case TokenType::LT: return leftVal < rightVal;
@@ -33,116 +26,167 @@ bool Evaluator::evaluateCondition(ASTNode* node) {
     }
 }
 
+template <bool Profiling>
 void Evaluator::executeBlock(ASTNode* node) {
     if (!node) return;
     
     for (ASTNode* child : node->children) {
-        evaluate(child);
+        visit<Profiling>(child);
+    }
+}
+
+const CountedLoop& Evaluator::loopShape(const ASTNode* loop) {
+    auto it = loopShapes.find(loop);
+    if (it == loopShapes.end()) {
+        CountedLoop shape;
+        matchCountedLoop(loop, shape);
+        it = loopShapes.insert(std::make_pair(loop, shape)).first;
+    }
+    return it->second;
+}
+
+// Same steps as the general প্রতিবার path, but the test and the increment
+// work on a local copy of the variable. The slot is still written every
+// iteration because the body may read it.
+void Evaluator::runCountedLoop(ASTNode* loop, const CountedLoop& shape) {
+    int& var = slots[shape.slot];
+    int bound = shape.boundIsSlot ? slots[shape.bound] : shape.bound;
+    int i = var;
+
+    while (countedLoopTest(shape.compare, i, bound)) {
+        for (ASTNode* child : loop->children) {
+            evaluate(child);
+        }
+        i = countedLoopStep(i, shape.step);
+        var = i;
+        budget.onBackEdge();
     }
 }
 
 int Evaluator::evaluate(ASTNode* node) {
+    return visit<false>(node);
+}
+
+template <bool Profiling>
+int Evaluator::visit(ASTNode* node) {
+    if (!Profiling || !node) return dispatch<Profiling>(node);
+    Profiler::Scope scope(*profiler, node->type);
+    return dispatch<true>(node);
+}
+
+template <bool Profiling>
+int Evaluator::dispatch(ASTNode* node) {
     if (!node) return 0;
 
-    switch (node->token.type) {
+    switch (node->type) {
         case TokenType::NUM:
-            return node->token.value;
+            return node->value;
 
         case TokenType::STRING:
             // Return length for now
-            return node->token.strValue.length();
+            return node->text.length();
 
         case TokenType::IDENTIFIER:
-            return getVariable(node->token.strValue);
+            if (Profiling) profiler->variables[node->slot].reads++;
+            return slots[node->slot];
 
         // Arithmetic operations
         case TokenType::PLUS:
         case TokenType::JOG:
-            return evaluate(node->left) + evaluate(node->right);
-
         case TokenType::MINUS:
         case TokenType::BIYOG:
-            return evaluate(node->left) - evaluate(node->right);
-
         case TokenType::MUL:
         case TokenType::GUN:
-            return evaluate(node->left) * evaluate(node->right);
-
         case TokenType::DIV:
         case TokenType::BHAG:
-            {
-                int rightVal = evaluate(node->right);
-                if (rightVal == 0) throw std::runtime_error("Division by zero");
-                return evaluate(node->left) / rightVal;
-            }
-
         case TokenType::ASSIGN:
-            {
-                int val = evaluate(node->right);
-                setVariable(node->left->token.strValue, val);
-                return val;
-            }
+            return evaluateExpression<Profiling>(node);
+
+        case TokenType::BORNO:
+            return runTextQuery(node->value, node->left->text.data, node->left->text.length());
 
         case TokenType::LEKHO:
             {
                 ASTNode* expr = node->left;
-                if (expr->token.type == TokenType::STRING) {
-                    std::cout << "লেখ: " << expr->token.strValue << std::endl;
+                if (expr->type == TokenType::STRING) {
+                    budget.chargeMemory(sizeof("লেখ: ") + expr->text.length());
+                    printTextLine(*out, expr->text.data, expr->text.length());
                 } else {
-                    int val = evaluate(expr);
-                    std::cout << "লেখ: " << val << std::endl;
+                    int val = visit<Profiling>(expr);
+                    budget.chargeMemory(sizeof("লেখ: ") + decimalLength(val));
+                    printNumberLine(*out, val);
                 }
                 return 0;
             }
 
         case TokenType::SHOROBORNO:
             {
-                std::string str = node->left->token.strValue;
-                bool hasVowel = isBanglaVowel(str);
-                std::cout << "স্বরবর্ণ আছে: " << (hasVowel ? "হ্যাঁ" : "না") << std::endl;
+                bool hasVowel = containsVowel(node->left->text.data, node->left->text.length());
+                budget.chargeMemory(sizeof("স্বরবর্ণ আছে: হ্যাঁ"));
+                printVowelLine(*out, hasVowel);
                 return hasVowel ? 1 : 0;
             }
 
         case TokenType::JODI: // যদি (if)
             {
-                if (evaluateCondition(node->left)) {
-                    executeBlock(node->right);
+                if (evaluateCondition<Profiling>(node->left)) {
+                    executeBlock<Profiling>(node->right);
                 } else if (node->extra) {
-                    executeBlock(node->extra);
+                    executeBlock<Profiling>(node->extra);
                 }
                 return 0;
             }
 
         case TokenType::JOTOKKHON: // যতক্ষণ (while)
             {
-                while (evaluateCondition(node->left)) {
-                    executeBlock(node->right);
+                Profiler::LoopStats* stats = Profiling ? &profiler->loop(node) : nullptr;
+                if (Profiling) stats->entries++;
+                while (evaluateCondition<Profiling>(node->left)) {
+                    if (Profiling) stats->iterations++;
+                    executeBlock<Profiling>(node->right);
+                    budget.onBackEdge();
                 }
                 return 0;
             }
 
         case TokenType::PROTIBAR: // প্রতিবার (for)
             {
+                Profiler::LoopStats* stats = Profiling ? &profiler->loop(node) : nullptr;
+                if (Profiling) stats->entries++;
+
                 // init
-                if (node->left) evaluate(node->left);
+                if (node->left) visit<Profiling>(node->left);
+
+                // A profile counts every node the source evaluates, so it
+                // always takes the general path
+                if (!Profiling) {
+                    const CountedLoop& shape = loopShape(node);
+                    if (shape.slot >= 0) {
+                        runCountedLoop(node, shape);
+                        return 0;
+                    }
+                }
 
                 // condition loop
-                while (node->right && evaluateCondition(node->right)) {
+                while (node->right && evaluateCondition<Profiling>(node->right)) {
+                    if (Profiling) stats->iterations++;
+
                     // body (first child of wrapper)
                     if (!node->children.empty()) {
                         for (ASTNode* child : node->children) {
-                            evaluate(child);
+                            visit<Profiling>(child);
                         }
                     }
 
                     // increment
-                    if (node->extra) evaluate(node->extra);
+                    if (node->extra) visit<Profiling>(node->extra);
+                    budget.onBackEdge();
                 }
                 return 0;
             }
 
         case TokenType::LBRACE:
-            executeBlock(node);
+            executeBlock<Profiling>(node);
             return 0;
 
         default:
@@ -150,8 +194,196 @@ int Evaluator::evaluate(ASTNode* node) {
     }
 }
 
-void Evaluator::executeProgram(ASTNode* node) {
-    evaluate(node);
+// A number or variable operand, read without any bookkeeping
+inline bool Evaluator::plainValue(const ASTNode* node, int& value) const {
+    if (!node) return false;
+    if (node->type == TokenType::NUM) {
+        value = node->value;
+        return true;
+    }
+    if (node->type == TokenType::IDENTIFIER) {
+        value = slots[node->slot];
+        return true;
+    }
+    return false;
+}
+
+inline int Evaluator::arithmetic(TokenType op, int left, int right) {
+    switch (op) {
+        case TokenType::PLUS: case TokenType::JOG: return left + right;
+        case TokenType::MINUS: case TokenType::BIYOG: return left - right;
+        case TokenType::MUL: case TokenType::GUN: return left * right;
+        default:
+            if (right == 0) throw std::runtime_error("Division by zero");
+            if (right == -1 && left == INT_MIN) throw std::runtime_error("Integer overflow");
+            return left / right;
+    }
+}
+
+// Arithmetic and assignments, the nodes with operands, take no native
+// stack however deep they nest: each operator still waiting for an operand
+// has a frame on an explicit stack instead. Operands are evaluated in the
+// same order as ever, a divisor before its dividend and checked before it.
+template <bool Profiling>
+int Evaluator::evaluateExpression(ASTNode* root) {
+    // Each run starts at the bottom of frames: expressions contain no
+    // statements, so this never nests
+    if (!Profiling) return runExpression<false>(root);
+
+    marks.clear();
+    try {
+        return runExpression<true>(root);
+    } catch (...) {
+        // Close the nodes still being evaluated, innermost first
+        for (size_t i = marks.size(); i-- > 0;) profiler->leave(frames[i + 1].node->type, marks[i]);
+        throw;
+    }
+}
+
+// frames is only storage: runExpression keeps the depth itself, which
+// saves the bookkeeping of push_back on every operator
+Evaluator::Frame* Evaluator::growFrames(size_t& capacity) {
+    frames.resize(2 * capacity + 16);
+    capacity = frames.size();
+    return frames.data();
+}
+
+static inline bool isDivision(TokenType type) {
+    return type == TokenType::DIV || type == TokenType::BHAG;
+}
+
+// The root is timed by the visit that got here; every node under it gets a
+// mark of its own. Without a profiler, operands that are numbers or
+// variables are read on the spot instead of being visited.
+template <bool Profiling>
+int Evaluator::runExpression(ASTNode* root) {
+    ASTNode* node = root;
+    int value, operand;
+    Frame* stack = frames.data();
+    size_t depth = 0, capacity = frames.size();
+    for (;;) {
+        // Down through operators, along the operand each evaluates first
+        for (bool leaf = false; !leaf;) {
+            switch (node ? node->type : TokenType::END) {
+                case TokenType::PLUS: case TokenType::JOG:
+                case TokenType::MINUS: case TokenType::BIYOG:
+                case TokenType::MUL: case TokenType::GUN:
+                case TokenType::DIV: case TokenType::BHAG:
+                    {
+                        bool divide = isDivision(node->type);
+                        ASTNode* first = divide ? node->right : node->left;
+                        ASTNode* second = divide ? node->left : node->right;
+                        if (depth == capacity) stack = growFrames(capacity);
+                        if (Profiling || !plainValue(first, operand)) {
+                            if (Profiling && depth) marks.push_back(profiler->enter());
+                            stack[depth++] = Frame{node, 0, false};
+                            node = first;
+                            break;
+                        }
+                        if (divide && operand == 0) throw std::runtime_error("Division by zero");
+                        int other;
+                        if (plainValue(second, other)) {
+                            value = divide ? arithmetic(node->type, other, operand) : arithmetic(node->type, operand, other);
+                            leaf = true;
+                        } else {
+                            stack[depth++] = Frame{node, operand, true};
+                            node = second;
+                        }
+                        break;
+                    }
+
+                case TokenType::ASSIGN:
+                    if (depth == capacity) stack = growFrames(capacity);
+                    if (Profiling && depth) marks.push_back(profiler->enter());
+                    stack[depth++] = Frame{node, 0, false};
+                    node = node->right;
+                    break;
+
+                case TokenType::NUM:
+                    value = Profiling ? visit<Profiling>(node) : node->value;
+                    leaf = true;
+                    break;
+
+                case TokenType::IDENTIFIER:
+                    value = Profiling ? visit<Profiling>(node) : slots[node->slot];
+                    leaf = true;
+                    break;
+
+                default:
+                    value = visit<Profiling>(node);
+                    leaf = true;
+                    break;
+            }
+        }
+
+        // Up: hand the value to the operators waiting for it
+        for (;;) {
+            if (depth == 0) return value;
+            Frame& frame = stack[depth - 1];
+            ASTNode* op = frame.node;
+
+            if (op->type == TokenType::ASSIGN) {
+                if (Profiling) profiler->variables[op->slot].writes++;
+                slots[op->slot] = value;
+            } else {
+                bool divide = isDivision(op->type);
+                if (!frame.second) {
+                    if (divide && value == 0) throw std::runtime_error("Division by zero");
+                    ASTNode* second = divide ? op->left : op->right;
+                    if (Profiling || !plainValue(second, operand)) {
+                        frame.first = value;
+                        frame.second = true;
+                        node = second;
+                        break;
+                    }
+                    frame.first = value;
+                    value = operand;
+                }
+                value = divide ? arithmetic(op->type, value, frame.first) : arithmetic(op->type, frame.first, value);
+            }
+
+            if (Profiling && depth > 1) {
+                profiler->leave(op->type, marks.back());
+                marks.pop_back();
+            }
+            depth--;
+        }
+    }
+}
+
+void Evaluator::loadSlots(const Program& program) {
+    slots.assign(program.slotNames.size(), 0);
+    for (size_t i = 0; i < slots.size(); i++) {
+        auto it = variables.find(program.slotNames[i]);
+        if (it != variables.end()) slots[i] = it->second;
+    }
+}
+
+void Evaluator::storeSlots(const Program& program) {
+    for (size_t i = 0; i < slots.size(); i++) {
+        variables[program.slotNames[i]] = slots[i];
+    }
+}
+
+void Evaluator::executeProgram(const Program& program) {
+    loopShapes.clear();  // keyed by node, so only valid for one program
+    loadSlots(program);
+    budget.start(limits);
+    budget.chargeMemory(slots.size() * sizeof(int));
+    try {
+        if (profiler) {
+            profiler->start(program);
+            visit<true>(program.root);
+        } else {
+            visit<false>(program.root);
+        }
+    } catch (...) {
+        storeSlots(program);
+        out->flush();
+        throw;
+    }
+    storeSlots(program);
+    out->flush();
 }
 
 void Evaluator::setVariable(const std::string& name, int value) {
@@ -159,8 +391,9 @@ void Evaluator::setVariable(const std::string& name, int value) {
 }
 
 int Evaluator::getVariable(const std::string& name) {
-    if (variables.find(name) == variables.end()) {
+    auto it = variables.find(name);
+    if (it == variables.end()) {
         return 0; // Default to 0 if not set
     }
-    return variables[name];
+    return it->second;
 }
@@ -1,18 +1,61 @@
 #pragma once
 #include "parser.h"
+#include "exec_limits.h"
+#include "output.h"
+#include "counted_loop.h"
+#include "profiler.h"
 #include <unordered_map>
 #include <string>
+#include <vector>
 
+// Tree-walking interpreter. While a program runs its variables live in a
+// flat array indexed by the slots the parser resolved; the name map only
+// backs setVariable/getVariable and is synced when a run starts and ends.
 class Evaluator {
     std::unordered_map<std::string, int> variables;
+    std::vector<int> slots;
+    std::unordered_map<const ASTNode*, CountedLoop> loopShapes;  // per প্রতিবার node
+    OutputSink* out;
+    ExecutionLimits limits;
+    ExecutionBudget budget;
+    Profiler* profiler = nullptr;
 
-    bool isBanglaVowel(const std::string& str);
-    bool evaluateCondition(ASTNode* node);
-    void executeBlock(ASTNode* node);
+    // An operator of the expression being evaluated, and the operand it
+    // evaluated first once second is set
+    struct Frame {
+        ASTNode* node;
+        int first;
+        bool second;
+    };
+    std::vector<Frame> frames;
+    std::vector<Profiler::Mark> marks;  // of frames[1..] while profiling
+
+    void loadSlots(const Program& program);
+    void storeSlots(const Program& program);
+
+    // Instantiated twice: with Profiling every node reports to profiler,
+    // without it there is no profiling code at all
+    template <bool Profiling> int visit(ASTNode* node);
+    template <bool Profiling> int dispatch(ASTNode* node);
+    bool plainValue(const ASTNode* node, int& value) const;
+    static int arithmetic(TokenType op, int left, int right);
+    template <bool Profiling> int evaluateExpression(ASTNode* root);
+    template <bool Profiling> int runExpression(ASTNode* root);
+    Frame* growFrames(size_t& capacity);
+    template <bool Profiling> bool evaluateCondition(ASTNode* node);
+    template <bool Profiling> void executeBlock(ASTNode* node);
+    const CountedLoop& loopShape(const ASTNode* loop);
+    void runCountedLoop(ASTNode* loop, const CountedLoop& shape);
 
 public:
+    Evaluator() : out(&standardOutput()) {}
+    void setOutput(OutputSink& sink) { out = &sink; }
+    void setLimits(const ExecutionLimits& newLimits) { limits = newLimits; }
+    void setProfiler(Profiler* p) { profiler = p; }  // nullptr turns profiling off
+
+    static bool isBanglaVowel(const std::string& str);
     int evaluate(ASTNode* node);
-    void executeProgram(ASTNode* node);
+    void executeProgram(const Program& program);
     void setVariable(const std::string& name, int value);
     int getVariable(const std::string& name);
 };
@@ -0,0 +1,59 @@
+#include "exec_limits.h"
+
+const uint64_t ExecutionBudget::CHECK_INTERVAL;
+
+const char* LimitExceeded::kindName() const {
+    switch (kind) {
+        case STEPS: return "step_limit";
+        case TIME: return "time_limit";
+        case MEMORY: return "memory_limit";
+    }
+    return "limit";
+}
+
+void ExecutionBudget::start(const ExecutionLimits& newLimits) {
+    limits = newLimits;
+    stepsUsed = 0;
+    memoryUsed = 0;
+    if (limits.timeoutMs) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeoutMs);
+    }
+    scheduleNextCheck();
+}
+
+void ExecutionBudget::resume() {
+    if (limits.timeoutMs) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeoutMs);
+    }
+}
+
+void ExecutionBudget::scheduleNextCheck() {
+    period = CHECK_INTERVAL;
+    // Land exactly on the first step past the limit
+    if (limits.maxSteps && limits.maxSteps - stepsUsed + 1 < period) {
+        period = limits.maxSteps - stepsUsed + 1;
+    }
+    countdown = period;
+}
+
+void ExecutionBudget::checkpoint() {
+    stepsUsed += period;
+
+    if (limits.maxSteps && stepsUsed > limits.maxSteps) {
+        throw LimitExceeded(LimitExceeded::STEPS,
+                            "Step limit exceeded (" + std::to_string(limits.maxSteps) +
+                            " loop iterations)");
+    }
+    if (limits.timeoutMs && std::chrono::steady_clock::now() > deadline) {
+        throw LimitExceeded(LimitExceeded::TIME,
+                            "Time limit exceeded (" + std::to_string(limits.timeoutMs) + " ms)");
+    }
+
+    scheduleNextCheck();
+}
+
+void ExecutionBudget::memoryExceeded() const {
+    throw LimitExceeded(LimitExceeded::MEMORY,
+                        "Memory limit exceeded (" + std::to_string(limits.maxMemoryBytes) +
+                        " bytes)");
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Per-run resource limits. Zero means unlimited.
+struct ExecutionLimits {
+    uint64_t maxSteps = 0;      // loop iterations (back-edges) across the program
+    uint32_t timeoutMs = 0;     // wall-clock time for executing the program
+    size_t maxMemoryBytes = 0;  // variables plus everything the program prints
+};
+
+// Thrown when a run goes over one of its limits
+class LimitExceeded : public std::runtime_error {
+public:
+    enum Kind { STEPS, TIME, MEMORY };
+    Kind kind;
+
+    LimitExceeded(Kind k, const std::string& message) : std::runtime_error(message), kind(k) {}
+
+    // Stable name for machine-readable reports ("step_limit", ...)
+    const char* kindName() const;
+};
+
+// Tracks one run against its limits. The hot path is onBackEdge(): a
+// decrement and a branch. The step total and the clock are only examined
+// every few thousand iterations (or sooner, to stop exactly on the limit).
+class ExecutionBudget {
+    ExecutionLimits limits;
+    uint64_t countdown = 0;
+    uint64_t period = 0;
+    uint64_t stepsUsed = 0;
+    size_t memoryUsed = 0;
+    std::chrono::steady_clock::time_point deadline;
+
+    static const uint64_t CHECK_INTERVAL = 4096;
+
+    void scheduleNextCheck();
+
+public:
+    // Resets counters and starts the clock
+    void start(const ExecutionLimits& newLimits);
+    // Starts the clock again for a run that was paused, keeping the steps
+    // and memory it used so far; the time limit applies to each stretch
+    void resume();
+
+    inline void onBackEdge() {
+        if (--countdown == 0) checkpoint();
+    }
+
+    // Generated code inlines onBackEdge(): it decrements the counter at
+    // countdownAddress() itself and calls checkpoint() when it hits zero
+    uint64_t* countdownAddress() { return &countdown; }
+    void checkpoint();
+
+    void chargeMemory(size_t bytes) {
+        memoryUsed += bytes;
+        if (limits.maxMemoryBytes && memoryUsed > limits.maxMemoryBytes) memoryExceeded();
+    }
+
+    [[noreturn]] void memoryExceeded() const;
+
+    uint64_t steps() const { return stepsUsed + (period - countdown); }
+    size_t memory() const { return memoryUsed; }
+};
+
+// Bytes needed to print v in decimal, for output accounting
+inline size_t decimalLength(int v) {
+    size_t n = v < 0 ? 2 : 1;
+    unsigned int u = v < 0 ? 0u - static_cast<unsigned int>(v) : static_cast<unsigned int>(v);
+    while (u >= 10) {
+        u /= 10;
+        n++;
+    }
+    return n;
+}
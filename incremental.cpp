@@ -0,0 +1,209 @@
+#include "incremental.h"
+#include <algorithm>
+#include <stdexcept>
+
+// Bytes the lexer may read past the end of a token to decide it
+static const size_t LOOKAHEAD = 3;
+
+// Source extent of a token; a string's includes its quotes (an unclosed
+// one runs to one past the end of the source)
+static size_t tokenStart(const Token& token) {
+    return token.type == TokenType::STRING ? token.offset - 1 : token.offset;
+}
+
+static size_t tokenEnd(const Token& token) {
+    return token.type == TokenType::STRING ? token.offset + token.length + 1 : token.offset + token.length;
+}
+
+// The parser only moves forward, so each lookup gallops on from the last
+ASTNode* EditSession::find(size_t at, size_t& end, int& height) {
+    size_t step = 1;
+    while (cursor + step < entries.size() && entries[cursor + step].firstToken < at) step *= 2;
+    auto it = std::lower_bound(entries.begin() + cursor + step / 2,
+                               entries.begin() + std::min(cursor + step, entries.size()), at,
+                               [](const Entry& entry, size_t token) { return entry.firstToken < token; });
+    cursor = it - entries.begin();
+    if (it == entries.end() || it->firstToken != at) return nullptr;
+    end = it->endToken;
+    height = it->height;
+    return it->node;
+}
+
+void EditSession::record(size_t at, size_t end, ASTNode* statement, int height) {
+    if (!recording) return;
+    Entry entry = {at, end, statement, height};
+    added.push_back(entry);
+}
+
+bool EditSession::reset(const std::string& source) {
+    text = source;
+    return parseAll();
+}
+
+bool EditSession::parseAll() {
+    tokensValid = false;
+    entries.clear();
+    tree.reset(new Program());
+    lexer.reset(new Lexer(text));
+    try {
+        tokenList = lexer->tokenize();
+    } catch (const SyntaxError& e) {
+        tokenList.clear();
+        parseErrors.assign(1, e.diagnostic);
+        return false;
+    }
+    tokensValid = true;
+    relexed = tokenList.size();
+    topLevel.clear();
+    topLevelEnds.clear();
+
+    // Most programs need fewer nodes than tokens, so one block usually fits
+    tree.reset(new Program(64 + tokenList.size() * sizeof(ASTNode)));
+    tree->root = tree->arena.make<ASTNode>(TokenType::LBRACE, 0, StringRef());
+    bool parsed = reparse();
+    compactAt = 2 * tree->arena.bytesReserved() + 65536;
+    return parsed;
+}
+
+bool EditSession::edit(size_t offset, size_t removed, const std::string& inserted) {
+    if (offset > text.size() || removed > text.size() - offset) {
+        throw std::out_of_range("Edit outside the source");
+    }
+    text.replace(offset, removed, inserted);
+
+    if (!tokensValid || tree->arena.bytesReserved() > compactAt) return parseAll();
+    try {
+        relex(offset, removed, inserted.size());
+    } catch (const SyntaxError& e) {
+        // The lexer only fails on numbers out of range; start over next time
+        tokensValid = false;
+        parseErrors.assign(1, e.diagnostic);
+        return false;
+    }
+    return reparse();
+}
+
+// text already holds the edited source; tokenList and entries still
+// describe the old one
+void EditSession::relex(size_t offset, size_t removed, size_t inserted) {
+    const size_t oldEnd = offset + removed;
+    const size_t count = tokenList.size() - 1;  // without END
+
+    // Old tokens [first, reuse) are replaced. The lexer looks a few bytes
+    // past a token (a stray lead byte is only invalid if the bytes after it
+    // do not complete a character), so tokens ending just before the edit
+    // are lexed again too.
+    size_t first = std::lower_bound(tokenList.begin(), tokenList.begin() + count, offset,
+                                    [](const Token& token, size_t at) { return tokenEnd(token) + LOOKAHEAD < at; }) -
+                   tokenList.begin();
+    size_t reuse = std::lower_bound(tokenList.begin() + first, tokenList.begin() + count, oldEnd,
+                                    [](const Token& token, size_t at) { return tokenStart(token) < at; }) -
+                   tokenList.begin();
+
+    std::vector<Token> fresh;
+    Token token(TokenType::END);
+    lexer->seek(first > 0 ? tokenEnd(tokenList[first - 1]) : 0);
+    bool synced = false;
+    while (lexer->nextToken(token)) {
+        size_t start = tokenStart(token);
+        while (reuse < count && tokenStart(tokenList[reuse]) - removed + inserted < start) reuse++;
+        if (reuse < count && tokenStart(tokenList[reuse]) - removed + inserted == start) {
+            synced = true;
+            break;
+        }
+        fresh.push_back(token);
+    }
+    if (!synced) reuse = count;
+    relexed = fresh.size();
+
+    // Splice, then move the reused tail (END included) by the edit
+    const size_t shiftedFrom = first + fresh.size();
+    if (fresh.size() < reuse - first) {
+        tokenList.erase(tokenList.begin() + shiftedFrom, tokenList.begin() + reuse);
+    } else {
+        tokenList.insert(tokenList.begin() + reuse, fresh.size() - (reuse - first), Token(TokenType::END));
+    }
+    std::copy(fresh.begin(), fresh.end(), tokenList.begin() + first);
+    for (size_t i = shiftedFrom; i < tokenList.size(); i++) {
+        tokenList[i].offset = static_cast<uint32_t>(tokenList[i].offset - removed + inserted);
+    }
+
+    // Forget statements that saw a replaced token (or had one right after
+    // them); renumber the ones after the edit. Loops also keep the source
+    // offset of their keyword.
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        Entry entry = entries[i];
+        if (entry.firstToken >= reuse) {
+            entry.firstToken = entry.firstToken - reuse + shiftedFrom;
+            entry.endToken = entry.endToken - reuse + shiftedFrom;
+            if (entry.node->type == TokenType::JOTOKKHON || entry.node->type == TokenType::PROTIBAR) {
+                entry.node->offset = static_cast<int>(entry.node->offset - removed + inserted);
+            }
+        } else if (entry.endToken >= first) {
+            continue;
+        }
+        entries[kept++] = entry;
+    }
+    entries.resize(kept);
+
+    size_t unchanged = std::lower_bound(topLevelEnds.begin(), topLevelEnds.end(), first) - topLevelEnds.begin();
+    topLevel.resize(unchanged);
+    topLevelEnds.resize(unchanged);
+}
+
+// Parses the top level again after the statements the edit left alone.
+// Remembered statements are taken as they are, so this only parses what
+// the edit invalidated.
+bool EditSession::reparse() {
+    Parser parser(tokenList, *lexer);
+    parser.setCache(this);
+    added.clear();
+    parseErrors.clear();
+    cursor = 0;
+
+    size_t at = topLevelEnds.empty() ? 0 : topLevelEnds.back();
+    bool failed = false;
+    try {
+        while (tokenList[at].type != TokenType::END) {
+            topLevel.push_back(parser.parseStatementAt(at, *tree));
+            topLevelEnds.push_back(at);
+        }
+    } catch (const SyntaxError& e) {
+        parseErrors.assign(1, e.diagnostic);
+        failed = true;
+    }
+    reparsed = added.size();
+
+    // Statements parsed before a syntax error are still good for later
+    std::sort(added.begin(), added.end(),
+              [](const Entry& a, const Entry& b) { return a.firstToken < b.firstToken; });
+    size_t middle = entries.size();
+    entries.insert(entries.end(), added.begin(), added.end());
+    std::inplace_merge(entries.begin(), entries.begin() + middle, entries.end(),
+                       [](const Entry& a, const Entry& b) { return a.firstToken < b.firstToken; });
+    added.clear();
+
+    if (failed) {
+        // Everything from the broken statement on, for the other errors;
+        // its trees are thrown away
+        std::vector<Diagnostic> all;
+        Program discarded(64 + (tokenList.size() - at) * sizeof(ASTNode));
+        Parser checker(tokenList, *lexer);
+        checker.setCache(this);
+        checker.setDiagnostics(&all);
+        recording = false;
+        cursor = 0;
+        checker.checkFrom(at, discarded);
+        recording = true;
+        if (!all.empty()) parseErrors.swap(all);
+        return false;
+    }
+    tree->root->children.items = topLevel.data();
+    tree->root->children.count = static_cast<uint32_t>(topLevel.size());
+    tree->slotNames.reserve(lexer->symbols().size());
+    for (size_t id = tree->slotNames.size(); id < lexer->symbols().size(); id++) {
+        tree->slotNames.push_back(lexer->symbols().name(static_cast<int>(id)));
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "lexer.h"
+#include "parser.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// A program kept parsed across edits, for editors that resubmit on every
+// keystroke. An edit replaces `removed` bytes at `offset` with `inserted`.
+//
+// Re-lexing starts after the last token that ends before the edit and
+// stops as soon as a new token starts where an old one did (shifted by
+// the edit): from there on the text, and so the tokens, are unchanged.
+//
+// Every statement parsed, nested or not, is remembered with its token
+// range. An edit forgets the statements whose tokens, or the token after
+// them, it touched, and shifts the ones after it. Reparsing walks the
+// top-level statements again, and the parser takes any remembered
+// statement that starts where it is looking (see StatementCache). So only
+// the statements around the edit are parsed again (and the walk starts
+// at the first top-level statement the edit touched). In a long block, that
+// is the block itself and the changed children, not all of them. The
+// result is always the tree a full parse would build, up to slot
+// numbering.
+//
+// Work per edit is proportional to the damaged statements, plus shifting
+// the indices and offsets of later tokens and statements. Trees from
+// replaced statements stay in the arena until it has grown to twice its
+// size after the last full parse; then the session starts over.
+//
+// While the source does not parse, diagnostics() lists every syntax error,
+// as a full parse would, and program() is not valid. Statements before the
+// first error are kept; the rest is parsed again to collect the errors,
+// taking remembered statements as they are but remembering nothing new, as
+// recovery leaves out broken parts. Later edits keep going incrementally
+// and can repair it.
+class EditSession : private StatementCache {
+    struct Entry {
+        size_t firstToken;
+        size_t endToken;  // one past the last token
+        ASTNode* node;
+        int height;
+    };
+
+    std::string text;
+    std::unique_ptr<Lexer> lexer;
+    std::vector<Token> tokenList;
+    std::unique_ptr<Program> tree;
+    std::vector<Entry> entries;  // by firstToken
+    std::vector<Entry> added;    // recorded by the current reparse
+    size_t cursor = 0;           // entries before it start before the parser
+    std::vector<ASTNode*> topLevel;
+    std::vector<size_t> topLevelEnds;  // token after each top-level statement
+    bool tokensValid = false;
+    std::vector<Diagnostic> parseErrors;  // every syntax error, if any
+    bool recording = true;                // record() keeps statements
+    size_t compactAt = 0;
+    size_t relexed = 0, reparsed = 0;
+
+    ASTNode* find(size_t at, size_t& end, int& height) override;
+    void record(size_t at, size_t end, ASTNode* statement, int height) override;
+
+    bool parseAll();
+    void relex(size_t offset, size_t removed, size_t inserted);
+    bool reparse();
+
+public:
+    explicit EditSession(const std::string& source = std::string()) { reset(source); }
+    // The lexer refers to text, so a session stays where it was made
+    EditSession(const EditSession&) = delete;
+    EditSession& operator=(const EditSession&) = delete;
+
+    // Replaces the whole source and parses it from scratch
+    bool reset(const std::string& source);
+
+    // Applies one edit. Returns false if the new source does not parse.
+    // Throws std::out_of_range if the edit is outside the source.
+    bool edit(size_t offset, size_t removed, const std::string& inserted);
+
+    bool ok() const { return parseErrors.empty(); }
+    std::string error() const { return ok() ? std::string() : parseErrors[0].message; }
+    const std::vector<Diagnostic>& diagnostics() const { return parseErrors; }
+    const std::string& source() const { return text; }
+    const std::vector<Token>& tokens() const { return tokenList; }
+
+    // The unoptimized tree, valid until the next edit. Later edits share
+    // parts of it, so do not run Optimizer on it.
+    const Program& program() const { return *tree; }
+
+    // Tokens lexed and statements parsed by the last edit
+    size_t tokensRelexed() const { return relexed; }
+    size_t statementsReparsed() const { return reparsed; }
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include "parser.h"
+#include "bytecode.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Mid-level representation between the AST and bytecode: a control-flow
+// graph of basic blocks in SSA form. A variable read names the instruction
+// that produced the value, so IrOptimizer moves and merges computations
+// without tracking which variable holds what, and IrLowering turns the
+// result back into a Chunk for the VM and the JIT.
+//
+// Blocks are kept in source order, which is also the order they are
+// lowered in: a যদি's condition, its then blocks, its else blocks, the
+// join; a loop's preheader, header (the condition), body ending in the
+// latch, then its exit. So a loop is a contiguous range of blocks, every
+// jump but a latch's goes forward, and a block comes after its immediate
+// dominator.
+
+enum class IrOp : uint8_t {
+    CONST,        // value
+    ENTRY,        // what variable slot `value` holds when the program starts
+    PHI,          // args[i] comes in from the block's preds[i]
+    COPY,         // args[0], as assigned to a variable
+    ADD, SUB, MUL,
+    DIV,          // args[0] / args[1], throws when args[1] is 0
+    CHECK_DIVISOR,  // args[0], after throwing if it is 0; a DIV's divisor
+                    // passes through one, ahead of the dividend's code
+    EQ, NEQ, LT, GT,  // 1 or 0
+    PRINT,        // লেখ args[0]
+    PRINT_STR,    // লেখ text
+    VOWEL_CHECK,  // স্বরবর্ণচেক(text)
+    FAIL          // throws text; stands in for a value, like OpCode::FAIL
+};
+
+struct IrInst {
+    IrOp op;
+    int block;       // -1 once a pass removes it
+    int args[2];
+    int value;       // CONST value, ENTRY slot
+    StringRef text;  // PRINT_STR, VOWEL_CHECK, FAIL
+};
+
+struct IrBlock {
+    std::vector<int> insts;  // phis first, then in execution order
+    int preds[2] = {-1, -1};
+    int predCount = 0;
+    // The block ends by branching on cond (to next when true, else
+    // orElse), or jumping to next when cond is -1. The last block has no
+    // next and halts.
+    int cond = -1;
+    int next = -1;
+    int orElse = -1;
+    int idom = -1;   // immediate dominator; -1 for the entry
+    int loop = -1;   // innermost loop the block is in
+};
+
+// Blocks header..latch; header - 1 is the preheader and latch + 1 the
+// exit, entered only from the header
+struct IrLoop {
+    int header;
+    int latch;
+    int parent;  // enclosing loop, or -1
+    int depth;   // 1 for an outermost loop
+};
+
+// Instruction ids index insts. Strings point into the parsed Program, so
+// it must outlive the IR.
+struct IrProgram {
+    std::vector<IrInst> insts;
+    std::vector<IrBlock> blocks;  // blocks[0] holds only CONST and ENTRY
+    std::vector<IrLoop> loops;
+    std::vector<std::string> slotNames;
+
+    // Value of CONST c, shared by everything that needs it
+    int constant(int c);
+    int add(int block, IrOp op, int a = -1, int b = -1);
+
+private:
+    std::unordered_map<int, int> constants;
+};
+
+// Builds the IR of a parsed program, mirroring Compiler statement for
+// statement: operands are evaluated in the same order, a condition that
+// is not a comparison still runs both sides, and so on. Expressions are
+// walked without recursion, like everywhere else.
+class IrBuilder {
+    IrProgram ir;
+    int current = 0;               // block being filled
+    std::vector<int> defs;         // value each slot holds here, or -1
+    std::vector<int> entries;      // ENTRY of each slot, or -1
+    std::vector<std::pair<int, int>> undo;  // slot, previous def
+    std::vector<int> loopStack;
+    std::vector<int> seen;         // stamps, for changesSince
+    int stamp = 0;
+
+    struct Pending {
+        ASTNode* node;
+        bool operandsDone;
+        bool divisorDone;  // division: divisor built and checked
+    };
+    std::vector<Pending> pending;
+    std::vector<int> values;
+
+    int newBlock(int idom);
+    void jump(int from, int to);
+    int emit(IrOp op, int a = -1, int b = -1);
+    int read(int slot);
+    void write(int slot, int value);
+    std::vector<std::pair<int, int>> changesSince(size_t mark);
+    void rollback(size_t mark);
+    std::vector<int> assignedSlots(const ASTNode* condition, const NodeList& body, const ASTNode* increment);
+
+    int buildExpression(ASTNode* root);
+    int buildCondition(ASTNode* node);
+    void buildStatement(ASTNode* node);
+    void buildBlock(ASTNode* node);
+    void buildLoop(ASTNode* condition, const NodeList& body, ASTNode* increment);
+
+public:
+    IrProgram build(const Program& program);
+};
+
+// Rewrites the IR so it computes the same output and errors with less
+// work. Variables are not part of what a program shows, since every run
+// starts from fresh ones, so a value no one reads is dropped however many
+// variables it was assigned to.
+class IrOptimizer {
+    IrProgram* ir = nullptr;
+    std::vector<int> forward;  // what each instruction was replaced by
+
+    int resolve(int value);
+    void replace(int inst, int by);
+    int constant(int c);
+    void rewriteArgs();
+    void dropReplaced();
+
+    void propagateCopies();
+    void numberValues();
+    void hoistLoopInvariants();
+    void removeDeadStores();
+
+public:
+    void optimize(IrProgram& target);
+};
+
+// Lowers IR to bytecode. Every SSA value that outlives the expression it
+// is computed in gets a slot: variable slots are reused once their
+// variable's values are dead, and more slots are added after them as
+// temporaries. A value needed only by the next instruction stays on the
+// operand stack, so straight-line code comes out as Compiler's does.
+// Output, errors and loop iterations match, but the variables a VM holds
+// afterwards do not: only the program's effects are kept.
+class IrLowering {
+public:
+    Chunk lower(const IrProgram& ir);
+};
@@ -0,0 +1,374 @@
+#include "ir.h"
+#include "bangla_text.h"
+
+int IrProgram::add(int block, IrOp op, int a, int b) {
+    IrInst inst;
+    inst.op = op;
+    inst.block = block;
+    inst.args[0] = a;
+    inst.args[1] = b;
+    inst.value = 0;
+    int id = static_cast<int>(insts.size());
+    insts.push_back(inst);
+    blocks[block].insts.push_back(id);
+    return id;
+}
+
+int IrProgram::constant(int c) {
+    auto it = constants.find(c);
+    if (it != constants.end()) return it->second;
+    int id = add(0, IrOp::CONST);
+    insts[id].value = c;
+    constants[c] = id;
+    return id;
+}
+
+int IrBuilder::newBlock(int idom) {
+    IrBlock block;
+    block.idom = idom;
+    block.loop = loopStack.empty() ? -1 : loopStack.back();
+    ir.blocks.push_back(block);
+    return static_cast<int>(ir.blocks.size()) - 1;
+}
+
+// Makes to a successor of from; a branch sets cond and orElse itself
+void IrBuilder::jump(int from, int to) {
+    if (ir.blocks[from].cond < 0 || ir.blocks[from].next < 0) ir.blocks[from].next = to;
+    else ir.blocks[from].orElse = to;
+    IrBlock& target = ir.blocks[to];
+    target.preds[target.predCount++] = from;
+}
+
+int IrBuilder::emit(IrOp op, int a, int b) {
+    return ir.add(current, op, a, b);
+}
+
+int IrBuilder::read(int slot) {
+    if (defs[slot] >= 0) return defs[slot];
+    if (entries[slot] < 0) {
+        entries[slot] = ir.add(0, IrOp::ENTRY);
+        ir.insts[entries[slot]].value = slot;
+    }
+    return entries[slot];
+}
+
+void IrBuilder::write(int slot, int value) {
+    undo.push_back(std::make_pair(slot, defs[slot]));
+    defs[slot] = value;
+}
+
+// Slots written since undo had mark entries, with what they hold now
+std::vector<std::pair<int, int>> IrBuilder::changesSince(size_t mark) {
+    std::vector<std::pair<int, int>> changes;
+    stamp++;
+    for (size_t i = mark; i < undo.size(); i++) {
+        int slot = undo[i].first;
+        if (seen[slot] == stamp) continue;
+        seen[slot] = stamp;
+        changes.push_back(std::make_pair(slot, defs[slot]));
+    }
+    return changes;
+}
+
+void IrBuilder::rollback(size_t mark) {
+    while (undo.size() > mark) {
+        defs[undo.back().first] = undo.back().second;
+        undo.pop_back();
+    }
+}
+
+// Every slot a loop's condition, body or increment assigns: each needs a
+// phi in the header. Walks a work list, as expressions nest any depth.
+std::vector<int> IrBuilder::assignedSlots(const ASTNode* condition, const NodeList& body,
+                                          const ASTNode* increment) {
+    std::vector<int> slots;
+    std::vector<const ASTNode*> unvisited(body.begin(), body.end());
+    unvisited.push_back(condition);
+    unvisited.push_back(increment);
+    stamp++;
+
+    while (!unvisited.empty()) {
+        const ASTNode* node = unvisited.back();
+        unvisited.pop_back();
+        if (!node) continue;
+        if (node->type == TokenType::ASSIGN && seen[node->slot] != stamp) {
+            seen[node->slot] = stamp;
+            slots.push_back(node->slot);
+        }
+
+        unvisited.push_back(node->left);
+        unvisited.push_back(node->right);
+        unvisited.push_back(node->extra);
+        for (const ASTNode* child : node->children) unvisited.push_back(child);
+    }
+    return slots;
+}
+
+int IrBuilder::buildExpression(ASTNode* root) {
+    // Expressions contain no statements, so this never nests
+    pending.clear();
+    values.clear();
+    pending.push_back(Pending{root, false, false});
+
+    while (!pending.empty()) {
+        Pending item = pending.back();
+        pending.pop_back();
+        ASTNode* node = item.node;
+        if (!node) {
+            values.push_back(ir.constant(0));
+            continue;
+        }
+
+        switch (node->type) {
+            case TokenType::NUM:
+                values.push_back(ir.constant(node->value));
+                break;
+
+            case TokenType::STRING:
+                values.push_back(ir.constant(static_cast<int>(node->text.length())));
+                break;
+
+            case TokenType::BORNO:
+                values.push_back(ir.constant(runTextQuery(node->value, node->left->text.data,
+                                                          node->left->text.length())));
+                break;
+
+            case TokenType::IDENTIFIER:
+                values.push_back(read(node->slot));
+                break;
+
+            case TokenType::PLUS: case TokenType::JOG:
+            case TokenType::MINUS: case TokenType::BIYOG:
+            case TokenType::MUL: case TokenType::GUN:
+                if (item.operandsDone) {
+                    int right = values.back();
+                    values.pop_back();
+                    int left = values.back();
+                    IrOp op = node->type == TokenType::PLUS || node->type == TokenType::JOG ? IrOp::ADD :
+                              node->type == TokenType::MINUS || node->type == TokenType::BIYOG ? IrOp::SUB :
+                              IrOp::MUL;
+                    values.back() = emit(op, left, right);
+                } else {
+                    pending.push_back(Pending{node, true, false});
+                    pending.push_back(Pending{node->right, false, false});
+                    pending.push_back(Pending{node->left, false, false});
+                }
+                break;
+
+            case TokenType::DIV: case TokenType::BHAG:
+                // The divisor is evaluated and checked first
+                if (item.operandsDone) {
+                    int left = values.back();
+                    values.pop_back();
+                    values.back() = emit(IrOp::DIV, left, values.back());
+                } else if (item.divisorDone) {
+                    values.back() = emit(IrOp::CHECK_DIVISOR, values.back());
+                    pending.push_back(Pending{node, true, false});
+                    pending.push_back(Pending{node->left, false, false});
+                } else {
+                    pending.push_back(Pending{node, false, true});
+                    pending.push_back(Pending{node->right, false, false});
+                }
+                break;
+
+            case TokenType::ASSIGN:
+                if (item.operandsDone) {
+                    values.back() = emit(IrOp::COPY, values.back());
+                    write(node->slot, values.back());
+                } else {
+                    pending.push_back(Pending{node, true, false});
+                    pending.push_back(Pending{node->right, false, false});
+                }
+                break;
+
+            default:
+                {
+                    // Comparisons (and anything else) are not values
+                    static const char message[] = "Unknown node type";
+                    int fail = emit(IrOp::FAIL);
+                    ir.insts[fail].text = StringRef(message, sizeof(message) - 1);
+                    values.push_back(fail);
+                    break;
+                }
+        }
+    }
+    return values.back();
+}
+
+int IrBuilder::buildCondition(ASTNode* node) {
+    if (!node) return ir.constant(0);
+
+    switch (node->type) {
+        case TokenType::EQ:
+        case TokenType::NEQ:
+        case TokenType::LT:
+        case TokenType::GT:
+            {
+                int left = buildExpression(node->left);
+                int right = buildExpression(node->right);
+                return emit(node->type == TokenType::EQ ? IrOp::EQ :
+                            node->type == TokenType::NEQ ? IrOp::NEQ :
+                            node->type == TokenType::LT ? IrOp::LT : IrOp::GT, left, right);
+            }
+
+        default:
+            // Not a comparison: operands still run, the condition is false
+            if (node->left) buildExpression(node->left);
+            if (node->right) buildExpression(node->right);
+            return ir.constant(0);
+    }
+}
+
+void IrBuilder::buildBlock(ASTNode* node) {
+    if (!node) return;
+
+    for (ASTNode* child : node->children) {
+        buildStatement(child);
+    }
+}
+
+// The header gets a phi for every slot the loop assigns, whose second
+// argument is filled in from the latch once the body is built. The exit
+// is reached from the header, so it sees the slots as the header left them.
+void IrBuilder::buildLoop(ASTNode* condition, const NodeList& body, ASTNode* increment) {
+    int preheader = current;
+    int index = static_cast<int>(ir.loops.size());
+    IrLoop loop;
+    loop.header = -1;
+    loop.latch = -1;
+    loop.parent = loopStack.empty() ? -1 : loopStack.back();
+    loop.depth = loop.parent < 0 ? 1 : ir.loops[loop.parent].depth + 1;
+    ir.loops.push_back(loop);
+    loopStack.push_back(index);
+
+    int header = newBlock(preheader);
+    jump(preheader, header);
+    ir.loops[index].header = header;
+    current = header;
+
+    std::vector<int> slots = assignedSlots(condition, body, increment);
+    std::vector<int> phis;
+    for (int slot : slots) {
+        phis.push_back(emit(IrOp::PHI, read(slot)));
+        write(slot, phis.back());
+    }
+    ir.blocks[header].cond = buildCondition(condition);
+    size_t mark = undo.size();
+
+    current = newBlock(header);
+    jump(header, current);
+    for (ASTNode* child : body) {
+        buildStatement(child);
+    }
+    if (increment) buildExpression(increment);
+
+    int latch = current;
+    jump(latch, header);
+    for (size_t i = 0; i < slots.size(); i++) {
+        ir.insts[phis[i]].args[1] = read(slots[i]);
+    }
+    rollback(mark);
+
+    loopStack.pop_back();
+    ir.loops[index].latch = latch;
+    current = newBlock(header);
+    jump(header, current);
+}
+
+void IrBuilder::buildStatement(ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case TokenType::LEKHO:
+            if (node->left->type == TokenType::STRING) {
+                ir.insts[emit(IrOp::PRINT_STR)].text = node->left->text;
+            } else {
+                emit(IrOp::PRINT, buildExpression(node->left));
+            }
+            break;
+
+        case TokenType::SHOROBORNO:
+            ir.insts[emit(IrOp::VOWEL_CHECK)].text = node->left->text;
+            break;
+
+        case TokenType::JODI: // যদি (if)
+            {
+                // Both arms start from the slots as the condition left
+                // them; where they end up differing, the join gets a phi
+                int condition = buildCondition(node->left);
+                int branch = current;
+                ir.blocks[branch].cond = condition;
+                size_t mark = undo.size();
+
+                current = newBlock(branch);
+                jump(branch, current);
+                buildBlock(node->right);
+                int thenEnd = current;
+                std::vector<std::pair<int, int>> thenDefs = changesSince(mark);
+                rollback(mark);
+
+                current = newBlock(branch);
+                jump(branch, current);
+                buildBlock(node->extra);
+                int elseEnd = current;
+                std::vector<std::pair<int, int>> elseDefs = changesSince(mark);
+                rollback(mark);
+
+                int join = newBlock(branch);
+                jump(thenEnd, join);
+                jump(elseEnd, join);
+                current = join;
+
+                std::unordered_map<int, int> elseValue(elseDefs.begin(), elseDefs.end());
+                for (const auto& def : thenDefs) {
+                    auto it = elseValue.find(def.first);
+                    int otherwise = it != elseValue.end() ? it->second : read(def.first);
+                    write(def.first, def.second == otherwise ? def.second : emit(IrOp::PHI, def.second, otherwise));
+                    if (it != elseValue.end()) elseValue.erase(it);
+                }
+                for (const auto& def : elseDefs) {
+                    if (!elseValue.count(def.first)) continue;  // merged above
+                    int before = read(def.first);
+                    write(def.first, def.second == before ? before : emit(IrOp::PHI, before, def.second));
+                }
+                break;
+            }
+
+        case TokenType::JOTOKKHON: // যতক্ষণ (while)
+            buildLoop(node->left, node->right ? node->right->children : NodeList(), nullptr);
+            break;
+
+        case TokenType::PROTIBAR: // প্রতিবার (for)
+            if (node->left) buildExpression(node->left);
+            if (!node->right) break;  // no condition: body never runs
+            buildLoop(node->right, node->children, node->extra);
+            break;
+
+        case TokenType::LBRACE:
+            buildBlock(node);
+            break;
+
+        default:
+            // Expression statement
+            buildExpression(node);
+            break;
+    }
+}
+
+IrProgram IrBuilder::build(const Program& program) {
+    ir = IrProgram();
+    ir.slotNames = program.slotNames;
+    size_t slots = program.slotNames.size();
+    defs.assign(slots, -1);
+    entries.assign(slots, -1);
+    seen.assign(slots, 0);
+    stamp = 0;
+    undo.clear();
+    loopStack.clear();
+
+    newBlock(-1);
+    current = newBlock(0);
+    jump(0, current);
+    buildStatement(program.root);
+    return std::move(ir);
+}
@@ -0,0 +1,801 @@
+#include "ir.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Where a value's consumer finds it, when that is the operand stack
+const int NOT_STACKED = -1;
+const int INTO_BRANCH = -2;  // the block's branch pops it
+const int INTO_COPIES = -3;  // stored straight into the next block's phis
+
+// Program points are half-positions: at 2p the instruction at position p
+// reads its operands, at 2p + 1 it writes its result. Each block has a
+// position before its first instruction, where its phis are defined, and
+// one after its last, where it reads the values its successor's phis
+// copy and the branch condition.
+struct Use {
+    int block;
+    int half;
+};
+
+// Sorted, disjoint, inclusive ranges of half-positions
+typedef std::vector<std::pair<int, int>> Segments;
+
+// A loop lowered to FOR_TEST/FOR_NEXT: the header only compares a phi
+// with something fixed, and the latch feeds the phi itself plus a constant
+struct ForLoop {
+    int phi = -1;  // induction variable; -1 if the loop is lowered as it is
+    int bound = -1;
+    int step = 0;
+    OpCode compare = OpCode::LT;
+    int index = -1;  // in chunk.loops
+};
+
+bool producesValue(IrOp op) {
+    return op != IrOp::PRINT && op != IrOp::PRINT_STR && op != IrOp::VOWEL_CHECK;
+}
+
+// Operands in the order the VM pops them off the stack, last on top
+int pushOrder(const IrInst& inst, int ops[2]) {
+    switch (inst.op) {
+        case IrOp::ADD: case IrOp::SUB: case IrOp::MUL:
+        case IrOp::EQ: case IrOp::NEQ: case IrOp::LT: case IrOp::GT:
+            ops[0] = inst.args[0];
+            ops[1] = inst.args[1];
+            return 2;
+        case IrOp::DIV:
+            ops[0] = inst.args[1];
+            ops[1] = inst.args[0];
+            return 2;
+        case IrOp::CHECK_DIVISOR:
+        case IrOp::PRINT:
+            ops[0] = inst.args[0];
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+OpCode opcodeFor(IrOp op) {
+    switch (op) {
+        case IrOp::ADD: return OpCode::ADD;
+        case IrOp::SUB: return OpCode::SUB;
+        case IrOp::MUL: return OpCode::MUL;
+        case IrOp::DIV: return OpCode::DIV;
+        case IrOp::CHECK_DIVISOR: return OpCode::CHECK_DIVISOR;
+        case IrOp::EQ: return OpCode::EQ;
+        case IrOp::NEQ: return OpCode::NEQ;
+        case IrOp::LT: return OpCode::LT;
+        case IrOp::GT: return OpCode::GT;
+        case IrOp::PRINT: return OpCode::PRINT;
+        case IrOp::PRINT_STR: return OpCode::PRINT_STR;
+        case IrOp::VOWEL_CHECK: return OpCode::VOWEL_CHECK;
+        default: return OpCode::FAIL;
+    }
+}
+
+bool disjoint(const Segments& a, const Segments& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i].second < b[j].first) i++;
+        else if (b[j].second < a[i].first) j++;
+        else return false;
+    }
+    return true;
+}
+
+void normalize(Segments& segments) {
+    std::sort(segments.begin(), segments.end());
+    size_t out = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (out > 0 && segments[i].first <= segments[out - 1].second + 1) {
+            segments[out - 1].second = std::max(segments[out - 1].second, segments[i].second);
+        } else {
+            segments[out++] = segments[i];
+        }
+    }
+    segments.resize(out);
+}
+
+class Lowering {
+    const IrProgram& ir;
+    Chunk chunk;
+    std::unordered_map<std::string, int> stringIndex;
+    int depth = 0;
+
+    std::vector<ForLoop> forLoops;      // by IR loop
+    std::vector<int> forLoopOfHeader;   // by block, -1 if none
+    std::vector<char> elided;           // computed by FOR_TEST/FOR_NEXT instead
+
+    // Layout
+    std::vector<std::vector<int>> code;  // by block: instructions lowered in it
+    std::vector<int> position, indexInBlock;
+    std::vector<int> blockStart, blockEnd;
+
+    // Reads of each value
+    std::vector<int> useStart;
+    std::vector<Use> uses;
+
+    // The operand stack
+    std::vector<int> stackedInto;   // consumer, NOT_STACKED, INTO_BRANCH or INTO_COPIES
+    std::vector<int> tileStart;     // index in its block where an instruction's operands start
+    std::vector<uint8_t> stackMask; // operands (bits in push order) already on the stack
+    std::vector<char> pushedEarly;  // first operand pushed at tileStart, before the second's code
+    std::unordered_map<int, std::vector<int>> pushBefore;
+    std::vector<char> needsSlot;
+
+    // Slots, by union-find class of values
+    std::vector<int> parent;
+    std::vector<Segments> live;
+    std::vector<int> pinned;   // variable slot an ENTRY value is already in
+    std::vector<int> slotOfClass;
+    int slotCount = 0;
+
+    std::vector<int> label;
+    std::vector<std::pair<int, int>> jumps;  // pc, target block
+
+    int useCount(int value) const { return useStart[value + 1] - useStart[value]; }
+    int defBlock(int value) const { return ir.insts[value].block; }
+    int defHalf(int value) const;
+    int find(int value);
+    bool isForLatchArg(int phi, int pred) const;
+
+    void findForLoops(const std::vector<int>& reads);
+    void layout();
+    void collectUses();
+    bool tileable(int block, int value, int index) const;
+    bool availableBefore(int block, int value, int index) const;
+    int phiArgsFrom(int block, int value) const;
+    void stackify();
+    void computeLiveness();
+    void coalesce();
+    void allocate();
+
+    int here() const { return static_cast<int>(chunk.code.size()); }
+    int emit(OpCode op, int32_t arg = 0);
+    int stringSlot(StringRef text);
+    int slotOf(int value);
+    void pushValue(int value);
+    void emitCopies(int block, int successor);
+    void emitBlock(int block);
+    void dropNeedlessJumps();
+
+public:
+    explicit Lowering(const IrProgram& program) : ir(program) {}
+    Chunk lower();
+};
+
+int Lowering::defHalf(int value) const {
+    const IrInst& inst = ir.insts[value];
+    if (inst.op == IrOp::ENTRY) return 1;
+    if (inst.op == IrOp::PHI) return 2 * blockStart[inst.block] + 1;
+    return 2 * position[value] + 1;
+}
+
+int Lowering::find(int value) {
+    while (parent[value] != value) {
+        parent[value] = parent[parent[value]];
+        value = parent[value];
+    }
+    return value;
+}
+
+// The phi's copy on its loop's back-edge, which FOR_NEXT does instead
+bool Lowering::isForLatchArg(int phi, int pred) const {
+    int block = ir.insts[phi].block;
+    int loop = forLoopOfHeader[block];
+    return loop >= 0 && forLoops[loop].phi == phi && pred == ir.loops[loop].latch;
+}
+
+// reads: how many instructions and branches use each value
+void Lowering::findForLoops(const std::vector<int>& reads) {
+    forLoops.assign(ir.loops.size(), ForLoop());
+    forLoopOfHeader.assign(ir.blocks.size(), -1);
+    elided.assign(ir.insts.size(), 0);
+
+    for (size_t l = 0; l < ir.loops.size(); l++) {
+        const IrLoop& loop = ir.loops[l];
+        const IrBlock& header = ir.blocks[loop.header];
+        int test = header.cond;
+        if (test < 0 || reads[test] != 1 || header.insts.empty() || header.insts.back() != test) continue;
+        bool onlyPhis = true;
+        for (size_t i = 0; i + 1 < header.insts.size(); i++) {
+            if (ir.insts[header.insts[i]].op != IrOp::PHI) onlyPhis = false;
+        }
+        const IrInst& compare = ir.insts[test];
+        if (!onlyPhis || compare.op < IrOp::EQ || compare.op > IrOp::GT) continue;
+
+        int phi = compare.args[0];
+        int bound = compare.args[1];
+        if (ir.insts[phi].op != IrOp::PHI || ir.insts[phi].block != loop.header) continue;
+        int boundBlock = ir.insts[bound].block;
+        if (boundBlock >= loop.header && boundBlock <= loop.latch) continue;
+
+        // phi + c, c + phi or phi - c around the back-edge
+        int next = ir.insts[phi].args[1];
+        const IrInst& step = ir.insts[next];
+        int a = step.args[0], b = step.args[1];
+        bool constA = a >= 0 && ir.insts[a].op == IrOp::CONST;
+        bool constB = b >= 0 && ir.insts[b].op == IrOp::CONST;
+        ForLoop counted;
+        if (step.op == IrOp::ADD && a == phi && constB) counted.step = ir.insts[b].value;
+        else if (step.op == IrOp::ADD && b == phi && constA) counted.step = ir.insts[a].value;
+        else if (step.op == IrOp::SUB && a == phi && constB) {
+            counted.step = static_cast<int>(0u - static_cast<unsigned int>(ir.insts[b].value));
+        } else {
+            continue;
+        }
+
+        counted.phi = phi;
+        counted.bound = bound;
+        counted.compare = opcodeFor(compare.op);
+        forLoops[l] = counted;
+        forLoopOfHeader[loop.header] = static_cast<int>(l);
+        elided[test] = 1;
+        // Needed by nothing but the phi, the step is FOR_NEXT's alone
+        if (reads[next] == 1) elided[next] = 1;
+    }
+}
+
+void Lowering::layout() {
+    size_t blocks = ir.blocks.size();
+    code.assign(blocks, std::vector<int>());
+    position.assign(ir.insts.size(), 0);
+    indexInBlock.assign(ir.insts.size(), -1);
+    blockStart.assign(blocks, 0);
+    blockEnd.assign(blocks, 0);
+
+    int pos = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        blockStart[b] = pos++;
+        for (int id : ir.blocks[b].insts) {
+            IrOp op = ir.insts[id].op;
+            if (op == IrOp::CONST || op == IrOp::ENTRY || op == IrOp::PHI || elided[id]) continue;
+            position[id] = pos++;
+            indexInBlock[id] = static_cast<int>(code[b].size());
+            code[b].push_back(id);
+        }
+        blockEnd[b] = pos++;
+    }
+}
+
+void Lowering::collectUses() {
+    std::vector<std::pair<int, Use>> found;
+    auto read = [&](int value, int block, int half) {
+        if (value >= 0 && ir.insts[value].op != IrOp::CONST) found.push_back(std::make_pair(value, Use{block, half}));
+    };
+
+    for (size_t b = 0; b < ir.blocks.size(); b++) {
+        const IrBlock& block = ir.blocks[b];
+        for (int id : block.insts) {
+            const IrInst& inst = ir.insts[id];
+            if (elided[id]) continue;
+            if (inst.op == IrOp::PHI) {
+                for (int k = 0; k < block.predCount; k++) {
+                    int pred = block.preds[k];
+                    if (!isForLatchArg(id, pred)) read(inst.args[k], pred, 2 * blockEnd[pred]);
+                }
+            } else {
+                read(inst.args[0], static_cast<int>(b), 2 * position[id]);
+                read(inst.args[1], static_cast<int>(b), 2 * position[id]);
+            }
+        }
+        if (block.cond >= 0 && forLoopOfHeader[b] < 0) read(block.cond, static_cast<int>(b), 2 * blockEnd[b]);
+    }
+    for (size_t l = 0; l < ir.loops.size(); l++) {
+        const ForLoop& loop = forLoops[l];
+        if (loop.phi < 0) continue;
+        int header = ir.loops[l].header, latch = ir.loops[l].latch;
+        read(loop.phi, header, 2 * blockEnd[header]);  // FOR_TEST
+        read(loop.bound, header, 2 * blockEnd[header]);
+        read(loop.phi, latch, 2 * blockEnd[latch]);    // FOR_NEXT
+    }
+
+    useStart.assign(ir.insts.size() + 1, 0);
+    for (const auto& use : found) useStart[use.first + 1]++;
+    for (size_t i = 0; i < ir.insts.size(); i++) useStart[i + 1] += useStart[i];
+    uses.resize(found.size());
+    std::vector<int> fill(useStart.begin(), useStart.end() - 1);
+    for (const auto& use : found) uses[fill[use.first]++] = use.second;
+}
+
+// value is the instruction at index in block and nothing consumes it yet
+bool Lowering::tileable(int block, int value, int index) const {
+    return index >= 0 && code[block][index] == value && stackedInto[value] == NOT_STACKED &&
+           producesValue(ir.insts[value].op);
+}
+
+// value can be pushed before the instruction at index runs
+bool Lowering::availableBefore(int block, int value, int index) const {
+    const IrInst& inst = ir.insts[value];
+    if (inst.op == IrOp::CONST || inst.op == IrOp::ENTRY || inst.op == IrOp::PHI || inst.block != block) return true;
+    return indexInBlock[value] >= 0 && indexInBlock[value] < index;
+}
+
+// How many phis of block's successor take value along this edge
+int Lowering::phiArgsFrom(int block, int value) const {
+    const IrBlock& successor = ir.blocks[ir.blocks[block].next];
+    int k = successor.preds[0] == block ? 0 : 1;
+    int count = 0;
+    for (int id : successor.insts) {
+        if (ir.insts[id].op != IrOp::PHI) break;
+        if (!isForLatchArg(id, block) && ir.insts[id].args[k] == value) count++;
+    }
+    return count;
+}
+
+// Decides which values go from one instruction to the next on the operand
+// stack. Code is lowered in IR order, so a consumer finds an operand on
+// the stack when the code computing it (with its own operands) ends right
+// where the consumer's operands start; the VM's stack order also needs the
+// stacked operands to be the first ones pushed. Anything else is read from
+// its slot.
+void Lowering::stackify() {
+    size_t n = ir.insts.size();
+    stackedInto.assign(n, NOT_STACKED);
+    tileStart.assign(n, 0);
+    stackMask.assign(n, 0);
+    pushedEarly.assign(n, 0);
+
+    for (size_t b = 0; b < ir.blocks.size(); b++) {
+        const std::vector<int>& list = code[b];
+        int block = static_cast<int>(b);
+        for (int k = 0; k < static_cast<int>(list.size()); k++) {
+            int consumer = list[k];
+            tileStart[consumer] = k;
+            int ops[2];
+            int count = pushOrder(ir.insts[consumer], ops);
+
+            if (count == 1 && tileable(block, ops[0], k - 1)) {
+                stackedInto[ops[0]] = consumer;
+                stackMask[consumer] = 1;
+                tileStart[consumer] = tileStart[ops[0]];
+            } else if (count == 2) {
+                int first = ops[0], second = ops[1];
+                bool done = false;
+                if (tileable(block, second, k - 1)) {
+                    int start = tileStart[second];
+                    if (tileable(block, first, start - 1)) {
+                        stackedInto[first] = stackedInto[second] = consumer;
+                        stackMask[consumer] = 3;
+                        tileStart[consumer] = tileStart[first];
+                        done = true;
+                    } else if (availableBefore(block, first, start)) {
+                        // Pushed ahead of the code computing the second
+                        stackedInto[second] = consumer;
+                        stackMask[consumer] = 2;
+                        pushedEarly[consumer] = 1;
+                        std::vector<int>& before = pushBefore[list[start]];
+                        before.insert(before.begin(), first);
+                        tileStart[consumer] = start;
+                        done = true;
+                    }
+                }
+                if (!done && tileable(block, first, k - 1)) {
+                    stackedInto[first] = consumer;
+                    stackMask[consumer] = 1;
+                    tileStart[consumer] = tileStart[first];
+                }
+            }
+        }
+
+        if (list.empty()) continue;
+        const IrBlock& info = ir.blocks[b];
+        int last = list.back();
+        if (stackedInto[last] != NOT_STACKED || !producesValue(ir.insts[last].op)) continue;
+        if (info.cond == last && forLoopOfHeader[b] < 0) {
+            stackedInto[last] = INTO_BRANCH;
+        } else if (info.cond < 0 && info.next >= 0 && useCount(last) > 0 &&
+                   phiArgsFrom(block, last) == useCount(last)) {
+            stackedInto[last] = INTO_COPIES;
+        }
+    }
+
+    needsSlot.assign(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        const IrInst& inst = ir.insts[i];
+        if (inst.block < 0 || elided[i] || inst.op == IrOp::CONST || !producesValue(inst.op)) continue;
+        int stackedUses = stackedInto[i] >= 0 || stackedInto[i] == INTO_BRANCH ? 1 : 0;
+        if (stackedInto[i] == INTO_COPIES) stackedUses = useCount(static_cast<int>(i));
+        needsSlot[i] = useCount(static_cast<int>(i)) > stackedUses;
+    }
+}
+
+// Where each value needing a slot is live, walking back from every read
+// to the definition through predecessors: the exact blocks, not the
+// whole stretch of code between
+void Lowering::computeLiveness() {
+    size_t n = ir.insts.size();
+    live.assign(n, Segments());
+    std::vector<int> visited(ir.blocks.size(), -1);
+    std::vector<int> work;
+
+    for (size_t v = 0; v < n; v++) {
+        if (!needsSlot[v]) continue;
+        int value = static_cast<int>(v);
+        int home = defBlock(value);
+        int def = defHalf(value);
+        Segments& segments = live[v];
+        segments.push_back(std::make_pair(def, def));
+
+        for (int u = useStart[v]; u < useStart[v + 1]; u++) {
+            const Use& use = uses[u];
+            if (use.block == home && use.half > def) {
+                segments.push_back(std::make_pair(def, use.half));
+                continue;
+            }
+            segments.push_back(std::make_pair(2 * blockStart[use.block], use.half));
+            work.push_back(use.block);
+            while (!work.empty()) {
+                const IrBlock& block = ir.blocks[work.back()];
+                work.pop_back();
+                for (int k = 0; k < block.predCount; k++) {
+                    int pred = block.preds[k];
+                    if (visited[pred] == value) continue;
+                    visited[pred] = value;
+                    if (pred == home) {
+                        segments.push_back(std::make_pair(def, 2 * blockEnd[pred] + 1));
+                    } else {
+                        segments.push_back(std::make_pair(2 * blockStart[pred], 2 * blockEnd[pred] + 1));
+                        work.push_back(pred);
+                    }
+                }
+            }
+        }
+        normalize(segments);
+    }
+}
+
+// A phi and its arguments share a slot wherever they are never live at
+// the same time, which makes the copies into the phi disappear: a loop
+// variable updated in place, a variable both arms of a যদি assign
+void Lowering::coalesce() {
+    size_t n = ir.insts.size();
+    parent.resize(n);
+    pinned.assign(n, -1);
+    for (size_t i = 0; i < n; i++) {
+        parent[i] = static_cast<int>(i);
+        if (needsSlot[i] && ir.insts[i].op == IrOp::ENTRY) pinned[i] = ir.insts[i].value;
+    }
+
+    for (const IrBlock& block : ir.blocks) {
+        for (int id : block.insts) {
+            const IrInst& phi = ir.insts[id];
+            if (phi.op != IrOp::PHI) break;
+            if (!needsSlot[id]) continue;
+            for (int k = 0; k < block.predCount; k++) {
+                int arg = phi.args[k];
+                if (isForLatchArg(id, block.preds[k]) || !needsSlot[arg]) continue;
+                int a = find(id), b = find(arg);
+                if (a == b || (pinned[a] >= 0 && pinned[b] >= 0) || !disjoint(live[a], live[b])) continue;
+                Segments merged(live[a]);
+                merged.insert(merged.end(), live[b].begin(), live[b].end());
+                normalize(merged);
+                live[a].swap(merged);
+                Segments().swap(live[b]);
+                pinned[a] = std::max(pinned[a], pinned[b]);
+                parent[b] = a;
+            }
+        }
+    }
+}
+
+// Linear scan over the classes' extents. Variable slots are handed out
+// like any other once free; ENTRY values keep the slot the VM loads them
+// into, and as they start the program they are placed first.
+void Lowering::allocate() {
+    size_t n = ir.insts.size();
+    std::vector<int> first(n, 0), last(n, -1);
+    std::vector<int> classes;
+    for (size_t i = 0; i < n; i++) {
+        if (!needsSlot[i]) continue;
+        int root = find(static_cast<int>(i));
+        if (last[root] < 0) {
+            classes.push_back(root);
+            first[root] = live[root].front().first;
+            last[root] = live[root].back().second;
+        }
+    }
+    // Copies into a phi that does not share its argument's slot write it
+    // at the end of the predecessor
+    for (const IrBlock& block : ir.blocks) {
+        for (int id : block.insts) {
+            const IrInst& phi = ir.insts[id];
+            if (phi.op != IrOp::PHI) break;
+            if (!needsSlot[id]) continue;
+            int root = find(id);
+            for (int k = 0; k < block.predCount; k++) {
+                int arg = phi.args[k];
+                int pred = block.preds[k];
+                if (!isForLatchArg(id, pred) && needsSlot[arg] && find(arg) == root) continue;
+                first[root] = std::min(first[root], 2 * blockEnd[pred] + 1);
+                last[root] = std::max(last[root], 2 * blockEnd[pred] + 1);
+            }
+        }
+    }
+
+    std::sort(classes.begin(), classes.end(), [&](int a, int b) {
+        if (first[a] != first[b]) return first[a] < first[b];
+        return pinned[a] > pinned[b];
+    });
+
+    int names = static_cast<int>(ir.slotNames.size());
+    std::set<int> free;
+    for (int s = 0; s < names; s++) free.insert(s);
+    typedef std::pair<int, int> Active;  // last half-position, slot
+    std::priority_queue<Active, std::vector<Active>, std::greater<Active>> active;
+    slotOfClass.assign(n, -1);
+    slotCount = names;
+
+    for (int root : classes) {
+        while (!active.empty() && active.top().first < first[root]) {
+            free.insert(active.top().second);
+            active.pop();
+        }
+        int slot;
+        if (pinned[root] >= 0) {
+            slot = pinned[root];
+            if (!free.erase(slot)) throw std::logic_error("IR lowering: variable slot taken");
+        } else if (!free.empty()) {
+            slot = *free.begin();
+            free.erase(free.begin());
+        } else {
+            slot = slotCount++;
+        }
+        slotOfClass[root] = slot;
+        active.push(std::make_pair(last[root], slot));
+    }
+}
+
+int Lowering::emit(OpCode op, int32_t arg) {
+    chunk.code.push_back(Instruction(op, arg));
+    depth += stackEffect(op);
+    if (depth > chunk.maxStack) chunk.maxStack = depth;
+    return here() - 1;
+}
+
+int Lowering::stringSlot(StringRef text) {
+    std::string str = text.str();
+    auto it = stringIndex.find(str);
+    if (it != stringIndex.end()) return it->second;
+    int slot = chunk.addString(str);
+    stringIndex[str] = slot;
+    return slot;
+}
+
+int Lowering::slotOf(int value) {
+    if (!needsSlot[value]) throw std::logic_error("IR lowering: value has no slot");
+    return slotOfClass[find(value)];
+}
+
+void Lowering::pushValue(int value) {
+    const IrInst& inst = ir.insts[value];
+    if (inst.op == IrOp::CONST) emit(OpCode::PUSH, inst.value);
+    else emit(OpCode::LOAD, slotOf(value));
+}
+
+// The phis of successor take their values from block, all at once: a
+// slot one copy writes may be one another reads, so copies go in an order
+// where no slot is written before it is read, and a cycle is broken by
+// keeping one old value on the operand stack
+void Lowering::emitCopies(int block, int successor) {
+    const IrBlock& next = ir.blocks[successor];
+    int k = next.preds[0] == block ? 0 : 1;
+
+    struct Move {
+        int dst;
+        int src;  // slot, or -1 for the value kept on the stack
+    };
+    std::vector<Move> moves;
+    std::vector<std::pair<int, int>> constants;  // slot, value
+    std::vector<int> fromStack;                  // slots for the INTO_COPIES value
+    for (int id : next.insts) {
+        const IrInst& phi = ir.insts[id];
+        if (phi.op != IrOp::PHI) break;
+        if (!needsSlot[id] || isForLatchArg(id, block)) continue;
+        int arg = phi.args[k];
+        int dst = slotOf(id);
+        if (ir.insts[arg].op == IrOp::CONST) constants.push_back(std::make_pair(dst, ir.insts[arg].value));
+        else if (stackedInto[arg] == INTO_COPIES) fromStack.push_back(dst);
+        else if (slotOf(arg) != dst) moves.push_back(Move{dst, slotOf(arg)});
+    }
+
+    int saved = 0;  // moves still reading the value kept on the stack
+    while (!moves.empty()) {
+        size_t ready = moves.size();
+        for (size_t i = 0; i < moves.size() && ready == moves.size(); i++) {
+            bool read = false;
+            for (size_t j = 0; j < moves.size(); j++) {
+                if (j != i && moves[j].src == moves[i].dst) read = true;
+            }
+            if (!read) ready = i;
+        }
+
+        if (ready == moves.size()) {
+            // Only cycles are left
+            if (saved) throw std::logic_error("IR lowering: unresolved copies");
+            int dst = moves[0].dst;
+            emit(OpCode::LOAD, dst);
+            for (Move& move : moves) {
+                if (move.src == dst) {
+                    move.src = -1;
+                    saved++;
+                }
+            }
+            continue;
+        }
+
+        Move move = moves[ready];
+        moves.erase(moves.begin() + ready);
+        if (move.src >= 0) {
+            emit(OpCode::LOAD, move.src);
+            emit(OpCode::STORE, move.dst);
+            emit(OpCode::POP);
+        } else {
+            emit(OpCode::STORE, move.dst);
+            if (--saved == 0) emit(OpCode::POP);
+        }
+    }
+
+    for (const auto& constant : constants) {
+        emit(OpCode::PUSH, constant.second);
+        emit(OpCode::STORE, constant.first);
+        emit(OpCode::POP);
+    }
+    if (!fromStack.empty()) {
+        for (int dst : fromStack) emit(OpCode::STORE, dst);
+        emit(OpCode::POP);
+    }
+}
+
+void Lowering::emitBlock(int b) {
+    const IrBlock& block = ir.blocks[b];
+    label[b] = here();
+
+    int counted = forLoopOfHeader[b];
+    if (counted >= 0) {
+        ForLoop& loop = forLoops[counted];
+        const IrInst& bound = ir.insts[loop.bound];
+        LoopSpec spec;
+        spec.slot = slotOf(loop.phi);
+        spec.compare = loop.compare;
+        spec.boundIsSlot = bound.op != IrOp::CONST;
+        spec.bound = spec.boundIsSlot ? slotOf(loop.bound) : bound.value;
+        spec.step = loop.step;
+        spec.test = here();
+        spec.exit = -1;  // once the exit block is placed
+        loop.index = static_cast<int>(chunk.loops.size());
+        chunk.loops.push_back(spec);
+        emit(OpCode::FOR_TEST, loop.index);
+    }
+
+    for (int id : code[b]) {
+        auto early = pushBefore.find(id);
+        if (early != pushBefore.end()) {
+            for (int value : early->second) pushValue(value);
+        }
+
+        const IrInst& inst = ir.insts[id];
+        int ops[2];
+        int count = pushOrder(inst, ops);
+        for (int i = 0; i < count; i++) {
+            if (stackMask[id] & (1 << i)) continue;
+            if (i == 0 && pushedEarly[id]) continue;
+            pushValue(ops[i]);
+        }
+
+        switch (inst.op) {
+            case IrOp::PRINT_STR:
+            case IrOp::VOWEL_CHECK:
+            case IrOp::FAIL:
+                emit(opcodeFor(inst.op), stringSlot(inst.text));
+                break;
+            default:
+                emit(opcodeFor(inst.op));
+                break;
+        }
+
+        if (producesValue(inst.op)) {
+            if (needsSlot[id]) emit(OpCode::STORE, slotOf(id));
+            if (stackedInto[id] == NOT_STACKED) emit(OpCode::POP);
+        }
+    }
+
+    if (block.cond < 0 && block.next >= 0) emitCopies(b, block.next);
+
+    if (counted >= 0) {
+        // FOR_TEST leaves the loop, the body follows
+    } else if (block.cond >= 0) {
+        // The condition may be an earlier block's, shared by value numbering
+        bool stacked = !code[b].empty() && code[b].back() == block.cond && stackedInto[block.cond] == INTO_BRANCH;
+        if (!stacked) pushValue(block.cond);
+        jumps.push_back(std::make_pair(emit(OpCode::JUMP_IF_FALSE), block.orElse));
+    } else if (block.next < 0) {
+        emit(OpCode::HALT);
+    } else if (block.next < b) {
+        int loop = forLoopOfHeader[block.next];
+        if (loop >= 0) emit(OpCode::FOR_NEXT, forLoops[loop].index);
+        else emit(OpCode::LOOP, label[block.next]);
+    } else {
+        jumps.push_back(std::make_pair(emit(OpCode::JUMP), block.next));
+    }
+}
+
+// Blocks fall into the next one more often than not: a jump to the very
+// next instruction goes, and everything after it moves up
+void Lowering::dropNeedlessJumps() {
+    for (;;) {
+        std::vector<Instruction>& code = chunk.code;
+        size_t n = code.size();
+        std::vector<int> moved(n + 1, 0);
+        int kept = 0;
+        for (size_t pc = 0; pc < n; pc++) {
+            moved[pc] = kept;
+            bool needless = code[pc].op == OpCode::JUMP && code[pc].arg == static_cast<int32_t>(pc) + 1;
+            if (!needless) kept++;
+        }
+        moved[n] = kept;
+        if (kept == static_cast<int>(n)) return;
+
+        std::vector<Instruction> compacted;
+        compacted.reserve(kept);
+        for (size_t pc = 0; pc < n; pc++) {
+            Instruction ins = code[pc];
+            if (ins.op == OpCode::JUMP && ins.arg == static_cast<int32_t>(pc) + 1) continue;
+            if (ins.op == OpCode::JUMP || ins.op == OpCode::LOOP || ins.op == OpCode::JUMP_IF_FALSE) {
+                ins.arg = moved[ins.arg];
+            }
+            compacted.push_back(ins);
+        }
+        code.swap(compacted);
+        for (LoopSpec& loop : chunk.loops) {
+            loop.test = moved[loop.test];
+            loop.exit = moved[loop.exit];
+        }
+    }
+}
+
+Chunk Lowering::lower() {
+    std::vector<int> reads(ir.insts.size(), 0);
+    for (const IrInst& inst : ir.insts) {
+        if (inst.block < 0) continue;
+        for (int arg : inst.args) {
+            if (arg >= 0) reads[arg]++;
+        }
+    }
+    for (const IrBlock& block : ir.blocks) {
+        if (block.cond >= 0) reads[block.cond]++;
+    }
+
+    findForLoops(reads);
+    layout();
+    collectUses();
+    stackify();
+    computeLiveness();
+    coalesce();
+    allocate();
+
+    for (const std::string& name : ir.slotNames) chunk.addName(name);
+    chunk.temporaries = static_cast<uint32_t>(slotCount - static_cast<int>(ir.slotNames.size()));
+    label.assign(ir.blocks.size(), -1);
+    for (size_t b = 1; b < ir.blocks.size(); b++) emitBlock(static_cast<int>(b));
+
+    for (const auto& jump : jumps) chunk.code[jump.first].arg = label[jump.second];
+    for (size_t l = 0; l < ir.loops.size(); l++) {
+        if (forLoops[l].phi >= 0) chunk.loops[forLoops[l].index].exit = label[ir.loops[l].latch + 1];
+    }
+    dropNeedlessJumps();
+    return chunk;
+}
+
+}  // namespace
+
+Chunk IrLowering::lower(const IrProgram& ir) {
+    Lowering lowering(ir);
+    return lowering.lower();
+}
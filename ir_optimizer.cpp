@@ -0,0 +1,279 @@
+#include "ir.h"
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+bool isComputation(IrOp op) {
+    switch (op) {
+        case IrOp::ADD: case IrOp::SUB: case IrOp::MUL: case IrOp::DIV:
+        case IrOp::EQ: case IrOp::NEQ: case IrOp::LT: case IrOp::GT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// A division by a known divisor other than 0 and -1 can never trap
+bool safeDivision(const IrProgram& ir, const IrInst& inst) {
+    const IrInst& divisor = ir.insts[inst.args[1]];
+    return divisor.op == IrOp::CONST && divisor.value != 0 && divisor.value != -1;
+}
+
+// Result of op on two constants, with the engines' wrap-around; false
+// for a division that must stay to raise its error
+bool fold(IrOp op, int a, int b, int& result) {
+    unsigned int ua = static_cast<unsigned int>(a), ub = static_cast<unsigned int>(b);
+    switch (op) {
+        case IrOp::ADD: result = static_cast<int>(ua + ub); return true;
+        case IrOp::SUB: result = static_cast<int>(ua - ub); return true;
+        case IrOp::MUL: result = static_cast<int>(ua * ub); return true;
+        case IrOp::DIV:
+            if (b == 0 || (a == INT_MIN && b == -1)) return false;
+            result = a / b;
+            return true;
+        case IrOp::EQ: result = a == b; return true;
+        case IrOp::NEQ: result = a != b; return true;
+        case IrOp::LT: result = a < b; return true;
+        default: result = a > b; return true;
+    }
+}
+
+struct ValueKey {
+    IrOp op;
+    int a, b;
+
+    bool operator==(const ValueKey& other) const { return op == other.op && a == other.a && b == other.b; }
+};
+
+struct ValueKeyHash {
+    size_t operator()(const ValueKey& key) const {
+        uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(key.a)) << 32) | static_cast<uint32_t>(key.b);
+        h ^= static_cast<uint64_t>(key.op) * 0x9e3779b97f4a7c15ULL;
+        h *= 0xc6a4a7935bd1e995ULL;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+}  // namespace
+
+int IrOptimizer::resolve(int value) {
+    if (value < 0) return value;
+    int root = value;
+    while (forward[root] != root) root = forward[root];
+    while (forward[value] != root) {
+        int next = forward[value];
+        forward[value] = root;
+        value = next;
+    }
+    return root;
+}
+
+void IrOptimizer::replace(int inst, int by) {
+    forward[inst] = by;
+    ir->insts[inst].block = -1;
+}
+
+int IrOptimizer::constant(int c) {
+    int id = ir->constant(c);
+    while (forward.size() < ir->insts.size()) forward.push_back(static_cast<int>(forward.size()));
+    return id;
+}
+
+void IrOptimizer::rewriteArgs() {
+    for (IrInst& inst : ir->insts) {
+        if (inst.block < 0) continue;
+        inst.args[0] = resolve(inst.args[0]);
+        inst.args[1] = resolve(inst.args[1]);
+    }
+    for (IrBlock& block : ir->blocks) block.cond = resolve(block.cond);
+}
+
+void IrOptimizer::dropReplaced() {
+    for (IrBlock& block : ir->blocks) {
+        block.insts.erase(std::remove_if(block.insts.begin(), block.insts.end(),
+                                         [this](int id) { return ir->insts[id].block < 0; }),
+                          block.insts.end());
+    }
+}
+
+// Assignments become the values assigned, and a phi whose arguments are
+// all one value (or itself, around a loop that never changes the
+// variable) becomes that value
+void IrOptimizer::propagateCopies() {
+    for (size_t i = 0; i < ir->insts.size(); i++) {
+        const IrInst& inst = ir->insts[i];
+        if (inst.block >= 0 && inst.op == IrOp::COPY) replace(static_cast<int>(i), inst.args[0]);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const IrBlock& block : ir->blocks) {
+            for (int id : block.insts) {
+                IrInst& phi = ir->insts[id];
+                if (phi.op != IrOp::PHI) break;
+                if (phi.block < 0) continue;
+                int a = resolve(phi.args[0]), b = resolve(phi.args[1]);
+                if (a == id) a = b;
+                if (b == id) b = a;
+                if (a == b && a != id) {
+                    replace(id, a);
+                    changed = true;
+                }
+            }
+        }
+    }
+    rewriteArgs();
+    dropReplaced();
+}
+
+// Common subexpressions: a computation whose operands were already
+// combined the same way in a dominating block reuses that result. A
+// division qualifies too, as the earlier one would have raised any error.
+// Computations on constants are folded on the way, and so is the check of
+// a constant divisor other than 0. Other divisor checks stay where they
+// are: they are neither computations nor ever shared.
+void IrOptimizer::numberValues() {
+    std::unordered_map<ValueKey, int, ValueKeyHash> known;
+    std::vector<ValueKey> added;  // in the order they went into known
+    std::vector<int> scopes;      // blocks on the dominator tree path
+    std::vector<size_t> marks;    // added.size() when each scope opened
+
+    // Blocks are in dominator tree preorder, so a block's scope closes
+    // when the walk leaves its subtree
+    for (size_t b = 1; b < ir->blocks.size(); b++) {
+        IrBlock& block = ir->blocks[b];
+        while (!scopes.empty() && scopes.back() != block.idom) {
+            while (added.size() > marks.back()) {
+                known.erase(added.back());
+                added.pop_back();
+            }
+            scopes.pop_back();
+            marks.pop_back();
+        }
+        scopes.push_back(static_cast<int>(b));
+        marks.push_back(added.size());
+
+        for (int id : block.insts) {
+            IrInst& inst = ir->insts[id];
+            inst.args[0] = resolve(inst.args[0]);
+            inst.args[1] = resolve(inst.args[1]);
+            if (inst.op == IrOp::CHECK_DIVISOR) {
+                const IrInst& divisor = ir->insts[inst.args[0]];
+                if (divisor.op == IrOp::CONST && divisor.value != 0) replace(id, inst.args[0]);
+                continue;
+            }
+            if (!isComputation(inst.op)) continue;
+
+            const IrInst& left = ir->insts[inst.args[0]];
+            const IrInst& right = ir->insts[inst.args[1]];
+            int result;
+            if (left.op == IrOp::CONST && right.op == IrOp::CONST && fold(inst.op, left.value, right.value, result)) {
+                replace(id, constant(result));
+                continue;
+            }
+
+            ValueKey key = {inst.op, inst.args[0], inst.args[1]};
+            bool commutative = inst.op == IrOp::ADD || inst.op == IrOp::MUL ||
+                               inst.op == IrOp::EQ || inst.op == IrOp::NEQ;
+            if (commutative && key.a > key.b) std::swap(key.a, key.b);
+            auto it = known.find(key);
+            if (it != known.end()) {
+                replace(id, it->second);
+            } else {
+                known.emplace(key, id);
+                added.push_back(key);
+            }
+        }
+        block.cond = resolve(block.cond);
+    }
+    rewriteArgs();
+    dropReplaced();
+}
+
+// Computations inside a loop whose operands all come from outside it move
+// to the preheader, inner loops first so a value can leave several
+// levels. They then run once even if the loop runs zero times, so only
+// what cannot fail moves.
+void IrOptimizer::hoistLoopInvariants() {
+    std::vector<int> order;
+    for (size_t i = 0; i < ir->loops.size(); i++) order.push_back(static_cast<int>(i));
+    std::stable_sort(order.begin(), order.end(),
+                     [this](int x, int y) { return ir->loops[x].depth > ir->loops[y].depth; });
+
+    for (int index : order) {
+        const IrLoop& loop = ir->loops[index];
+        int preheader = loop.header - 1;
+        auto inside = [&](int value) {
+            int block = ir->insts[value].block;
+            return block >= loop.header && block <= loop.latch;
+        };
+
+        for (int b = loop.header; b <= loop.latch; b++) {
+            IrBlock& block = ir->blocks[b];
+            bool moved = false;
+            for (int id : block.insts) {
+                IrInst& inst = ir->insts[id];
+                if (!isComputation(inst.op) || (inst.op == IrOp::DIV && !safeDivision(*ir, inst))) continue;
+                if (inside(inst.args[0]) || inside(inst.args[1])) continue;
+                inst.block = preheader;
+                ir->blocks[preheader].insts.push_back(id);
+                moved = true;
+            }
+            if (moved) {
+                block.insts.erase(std::remove_if(block.insts.begin(), block.insts.end(),
+                                                 [&](int id) { return ir->insts[id].block != b; }),
+                                  block.insts.end());
+            }
+        }
+    }
+}
+
+// Keeps what the program shows (output, errors, the conditions deciding
+// what runs) and everything those read; the rest goes. That includes an
+// assignment never read, and a variable only ever read by its own update,
+// such as a counter no one prints.
+void IrOptimizer::removeDeadStores() {
+    std::vector<char> live(ir->insts.size(), 0);
+    std::vector<int> work;
+    for (size_t i = 0; i < ir->insts.size(); i++) {
+        const IrInst& inst = ir->insts[i];
+        if (inst.block < 0) continue;
+        bool effect = inst.op == IrOp::PRINT || inst.op == IrOp::PRINT_STR || inst.op == IrOp::VOWEL_CHECK ||
+                      inst.op == IrOp::FAIL || inst.op == IrOp::CHECK_DIVISOR ||
+                      (inst.op == IrOp::DIV && !safeDivision(*ir, inst));
+        if (effect) work.push_back(static_cast<int>(i));
+    }
+    for (const IrBlock& block : ir->blocks) {
+        if (block.cond >= 0) work.push_back(block.cond);
+    }
+
+    while (!work.empty()) {
+        int id = work.back();
+        work.pop_back();
+        if (live[id]) continue;
+        live[id] = 1;
+        for (int arg : ir->insts[id].args) {
+            if (arg >= 0 && !live[arg]) work.push_back(arg);
+        }
+    }
+
+    // Constants and entry values stay: they cost nothing at run time
+    for (size_t i = 0; i < ir->insts.size(); i++) {
+        IrInst& inst = ir->insts[i];
+        if (inst.block > 0 && !live[i]) inst.block = -1;
+    }
+    dropReplaced();
+}
+
+void IrOptimizer::optimize(IrProgram& target) {
+    ir = &target;
+    forward.resize(ir->insts.size());
+    for (size_t i = 0; i < forward.size(); i++) forward[i] = static_cast<int>(i);
+
+    propagateCopies();
+    numberValues();
+    hoistLoopInvariants();
+    removeDeadStores();
+}
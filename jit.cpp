@@ -0,0 +1,563 @@
+#include "jit.h"
+#include "bangla_text.h"
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BANGLA_JIT 1
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+void Jit::setVariable(const std::string& name, int value) {
+    variables[name] = value;
+}
+
+int Jit::getVariable(const std::string& name) {
+    auto it = variables.find(name);
+    return it == variables.end() ? 0 : it->second;
+}
+
+#ifndef BANGLA_JIT
+
+bool Jit::run(const ChunkView&) {
+    return false;
+}
+
+#else
+
+namespace {
+
+// Shared by the generated code and the callbacks it makes
+struct NativeContext {
+    int32_t failIndex;  // FAIL: index of the message in chunk->strings
+    OutputSink* out;
+    ExecutionBudget* budget;
+    const ChunkView* chunk;
+    std::exception_ptr* error;  // set by a callback before it returns non-zero
+};
+
+// Return value of the generated function
+enum NativeStatus {
+    NATIVE_HALT = 0,
+    NATIVE_ERROR = 1,     // a callback caught an exception
+    NATIVE_FAIL = 2,      // FAIL instruction
+    NATIVE_DIV_ZERO = 3,
+    NATIVE_OVERFLOW = 4   // INT_MIN / -1, which idiv traps on
+};
+
+typedef int (*NativeEntry)(int* vars, int* stack, NativeContext* context, uint64_t* countdown);
+
+// Callbacks. They run the same code as the VM and turn any exception into
+// a status, because the generated frames have no unwind information.
+int nativePrint(NativeContext* context, int value) {
+    try {
+        context->budget->chargeMemory(sizeof("লেখ: ") + decimalLength(value));
+        printNumberLine(*context->out, value);
+        return 0;
+    } catch (...) {
+        *context->error = std::current_exception();
+        return 1;
+    }
+}
+
+int nativePrintString(NativeContext* context, int index) {
+    try {
+        StringRef text = context->chunk->string(index);
+        context->budget->chargeMemory(sizeof("লেখ: ") + text.size);
+        printTextLine(*context->out, text.data, text.size);
+        return 0;
+    } catch (...) {
+        *context->error = std::current_exception();
+        return 1;
+    }
+}
+
+int nativeVowelCheck(NativeContext* context, int index) {
+    try {
+        StringRef text = context->chunk->string(index);
+        bool hasVowel = containsVowel(text.data, text.size);
+        context->budget->chargeMemory(sizeof("স্বরবর্ণ আছে: হ্যাঁ"));
+        printVowelLine(*context->out, hasVowel);
+        return 0;
+    } catch (...) {
+        *context->error = std::current_exception();
+        return 1;
+    }
+}
+
+int nativeCheckpoint(NativeContext* context, int) {
+    try {
+        context->budget->checkpoint();
+        return 0;
+    } catch (...) {
+        *context->error = std::current_exception();
+        return 1;
+    }
+}
+
+enum Reg {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+#ifdef _WIN32
+const Reg ARG0 = RCX, ARG1 = RDX, ARG2 = R8, ARG3 = R9;
+const uint8_t SHADOW_SPACE = 32;
+#else
+const Reg ARG0 = RDI, ARG1 = RSI, ARG2 = RDX, ARG3 = RCX;
+const uint8_t SHADOW_SPACE = 0;
+#endif
+
+// Registers the generated code keeps for its whole run (all callee-saved)
+const Reg VARS = RBX;       // int[] of variable slots
+const Reg STACK = R12;      // int[] operand stack; position k is at [STACK + 4k]
+const Reg CONTEXT = R13;    // NativeContext*
+const Reg COUNTDOWN = R14;  // ExecutionBudget countdown
+
+// Condition codes (low nibble of Jcc / SETcc)
+enum Cond { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+Cond invert(Cond cc) { return static_cast<Cond>(cc ^ 1); }
+
+// Just enough of an x86-64 encoder for the VM's instruction set
+class Assembler {
+    std::vector<uint8_t> bytes;
+    std::vector<int32_t> labels;                // code offset, -1 until bound
+    std::vector<std::pair<size_t, int>> fixups;  // rel32 position, label
+
+    void rex(bool wide, int reg, int rm) {
+        uint8_t prefix = 0x40 | (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0);
+        if (prefix != 0x40) byte(prefix);
+    }
+
+    void rel32(int label) {
+        fixups.push_back(std::make_pair(bytes.size(), label));
+        u32(0);
+    }
+
+public:
+    const std::vector<uint8_t>& code() const { return bytes; }
+
+    void byte(uint8_t b) { bytes.push_back(b); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(v >> (8 * i))); }
+
+    int newLabel() {
+        labels.push_back(-1);
+        return static_cast<int>(labels.size()) - 1;
+    }
+    void bind(int label) { labels[label] = static_cast<int32_t>(bytes.size()); }
+
+    // <opcode> reg, [base + disp32]
+    void memory(std::initializer_list<uint8_t> opcode, int reg, int base, int32_t disp,
+                bool wide = false) {
+        rex(wide, reg, base);
+        for (uint8_t b : opcode) byte(b);
+        byte(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == RSP) byte(0x24);  // SIB: no index
+        u32(static_cast<uint32_t>(disp));
+    }
+
+    // <opcode> reg, rm (register form)
+    void registers(std::initializer_list<uint8_t> opcode, int reg, int rm, bool wide = false) {
+        rex(wide, reg, rm);
+        for (uint8_t b : opcode) byte(b);
+        byte(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+    }
+
+    void load(Reg dst, Reg base, int32_t disp) { memory({0x8B}, dst, base, disp); }
+    void store(Reg src, Reg base, int32_t disp) { memory({0x89}, src, base, disp); }
+    void storeImm(Reg base, int32_t disp, int32_t imm) {
+        memory({0xC7}, 0, base, disp);
+        u32(static_cast<uint32_t>(imm));
+    }
+    void addImm(Reg base, int32_t disp, int32_t imm) {
+        memory({0x81}, 0, base, disp);
+        u32(static_cast<uint32_t>(imm));
+    }
+    void movImm(Reg dst, int32_t imm) {
+        rex(false, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 + (dst & 7)));
+        u32(static_cast<uint32_t>(imm));
+    }
+    void movRegs(Reg dst, Reg src) { registers({0x89}, src, dst, true); }
+    void cmpEaxImm(int32_t imm) {
+        byte(0x3D);
+        u32(static_cast<uint32_t>(imm));
+    }
+    void cmpImm8(Reg r, int8_t imm) {
+        registers({0x83}, 7, r);  // cmp r32, imm8
+        byte(static_cast<uint8_t>(imm));
+    }
+    void test(Reg r) { registers({0x85}, r, r); }
+
+    void push(Reg r) { rex(false, 0, r); byte(static_cast<uint8_t>(0x50 + (r & 7))); }
+    void pop(Reg r) { rex(false, 0, r); byte(static_cast<uint8_t>(0x58 + (r & 7))); }
+
+    void jump(int label) { byte(0xE9); rel32(label); }
+    void jumpIf(Cond cc, int label) { byte(0x0F); byte(static_cast<uint8_t>(0x80 + cc)); rel32(label); }
+    void setFlag(Cond cc) {
+        // setcc al; movzx eax, al
+        byte(0x0F); byte(static_cast<uint8_t>(0x90 + cc)); byte(0xC0);
+        byte(0x0F); byte(0xB6); byte(0xC0);
+    }
+
+    void call(const void* function) {
+        byte(0x48); byte(0xB8);  // mov rax, imm64
+        u64(reinterpret_cast<uint64_t>(function));
+        byte(0xFF); byte(0xD0);  // call rax
+    }
+
+    // Patches every jump; false if one targets a label that was never bound
+    bool finish() {
+        for (const auto& fixup : fixups) {
+            int32_t target = labels[fixup.second];
+            if (target < 0) return false;
+            int32_t rel = target - static_cast<int32_t>(fixup.first + 4);
+            for (int i = 0; i < 4; i++) bytes[fixup.first + i] = static_cast<uint8_t>(rel >> (8 * i));
+        }
+        return true;
+    }
+};
+
+Cond conditionFor(OpCode op) {
+    switch (op) {
+        case OpCode::EQ: return CC_E;
+        case OpCode::NEQ: return CC_NE;
+        case OpCode::LT: return CC_L;
+        default: return CC_G;
+    }
+}
+
+int32_t stackSlot(int position) {
+    return 4 * position;
+}
+
+// Calls callback(context, <ARG1 as already loaded>) and leaves on failure
+void emitCallback(Assembler& a, const void* callback, int errorLabel) {
+    a.movRegs(ARG0, CONTEXT);
+    a.call(callback);
+    a.test(RAX);
+    a.jumpIf(CC_NE, errorLabel);
+}
+
+// Inlined ExecutionBudget::onBackEdge() followed by the jump
+void emitBackEdge(Assembler& a, int target, int errorLabel) {
+    a.memory({0xFF}, 1, COUNTDOWN, 0, true);  // dec qword [COUNTDOWN]
+    a.jumpIf(CC_NE, target);
+    a.movImm(ARG1, 0);
+    emitCallback(a, reinterpret_cast<const void*>(&nativeCheckpoint), errorLabel);
+    a.jump(target);
+}
+
+// Translates chunk into native code. Every jump the compiler emits happens
+// with an empty operand stack, so the depth before each instruction is
+// known statically and stack positions become fixed memory operands.
+bool translate(const ChunkView& chunk, Assembler& a) {
+    const Instruction* code = chunk.code;
+    size_t n = chunk.codeSize;
+    if (n == 0 || code[n - 1].op != OpCode::HALT) return false;
+
+    std::vector<int> depthAt(n);
+    std::vector<bool> isTarget(n + 1, false);
+    int depth = 0;
+    for (size_t pc = 0; pc < n; pc++) {
+        const Instruction& ins = code[pc];
+        depthAt[pc] = depth;
+        depth += stackEffect(ins.op);
+        if (depth < 0 || depth > chunk.maxStack) return false;
+
+        switch (ins.op) {
+            case OpCode::JUMP:
+            case OpCode::LOOP:
+            case OpCode::JUMP_IF_FALSE:
+                if (depth != 0 || ins.arg < 0 || static_cast<size_t>(ins.arg) > n) return false;
+                isTarget[ins.arg] = true;
+                break;
+
+            case OpCode::FOR_TEST:
+            case OpCode::FOR_NEXT:
+                {
+                    if (depth != 0 || ins.arg < 0 || static_cast<size_t>(ins.arg) >= chunk.loopCount) {
+                        return false;
+                    }
+                    const LoopSpec& loop = chunk.loops[ins.arg];
+                    if (loop.test < 0 || static_cast<size_t>(loop.exit) > n) return false;
+                    isTarget[loop.test] = true;
+                    isTarget[loop.exit] = true;
+                    break;
+                }
+
+            default:
+                break;
+        }
+    }
+
+    std::vector<int> labelAt(n + 1);
+    for (size_t pc = 0; pc <= n; pc++) labelAt[pc] = a.newLabel();
+    int exitLabel = a.newLabel();
+    int errorLabel = a.newLabel();
+    int divZeroLabel = a.newLabel();
+    int overflowLabel = a.newLabel();
+
+    // Prologue: five pushes keep the stack 16-byte aligned for calls
+    a.push(RBX); a.push(R12); a.push(R13); a.push(R14); a.push(R15);
+    if (SHADOW_SPACE) { a.byte(0x48); a.byte(0x83); a.byte(0xEC); a.byte(SHADOW_SPACE); }  // sub rsp
+    a.movRegs(VARS, ARG0);
+    a.movRegs(STACK, ARG1);
+    a.movRegs(CONTEXT, ARG2);
+    a.movRegs(COUNTDOWN, ARG3);
+
+    for (size_t pc = 0; pc < n; pc++) {
+        const Instruction& ins = code[pc];
+        int d = depthAt[pc];
+        a.bind(labelAt[pc]);
+
+        switch (ins.op) {
+            case OpCode::PUSH:
+                a.storeImm(STACK, stackSlot(d), ins.arg);
+                break;
+
+            case OpCode::LOAD:
+                a.load(RAX, VARS, 4 * ins.arg);
+                a.store(RAX, STACK, stackSlot(d));
+                break;
+
+            case OpCode::STORE:
+                a.load(RAX, STACK, stackSlot(d - 1));
+                a.store(RAX, VARS, 4 * ins.arg);
+                break;
+
+            case OpCode::POP:
+                break;
+
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+                a.load(RAX, STACK, stackSlot(d - 2));
+                if (ins.op == OpCode::ADD) a.memory({0x03}, RAX, STACK, stackSlot(d - 1));
+                else if (ins.op == OpCode::SUB) a.memory({0x2B}, RAX, STACK, stackSlot(d - 1));
+                else a.memory({0x0F, 0xAF}, RAX, STACK, stackSlot(d - 1));
+                a.store(RAX, STACK, stackSlot(d - 2));
+                break;
+
+            case OpCode::DIV:
+                // [.., right, left] -> left / right
+                a.load(RCX, STACK, stackSlot(d - 2));
+                a.test(RCX);
+                a.jumpIf(CC_E, divZeroLabel);
+                a.load(RAX, STACK, stackSlot(d - 1));
+                {
+                    int divide = a.newLabel();
+                    a.cmpImm8(RCX, -1);
+                    a.jumpIf(CC_NE, divide);
+                    a.cmpEaxImm(INT_MIN);
+                    a.jumpIf(CC_E, overflowLabel);
+                    a.bind(divide);
+                }
+                a.byte(0x99);                    // cdq
+                a.registers({0xF7}, 7, RCX);     // idiv ecx
+                a.store(RAX, STACK, stackSlot(d - 2));
+                break;
+
+            case OpCode::CHECK_DIVISOR:
+                a.load(RCX, STACK, stackSlot(d - 1));
+                a.test(RCX);
+                a.jumpIf(CC_E, divZeroLabel);
+                break;
+
+            case OpCode::EQ:
+            case OpCode::NEQ:
+            case OpCode::LT:
+            case OpCode::GT:
+                a.load(RAX, STACK, stackSlot(d - 2));
+                a.memory({0x3B}, RAX, STACK, stackSlot(d - 1));  // cmp eax, right
+                if (pc + 1 < n && code[pc + 1].op == OpCode::JUMP_IF_FALSE && !isTarget[pc + 1]) {
+                    // Compare and branch without materializing the flag
+                    a.jumpIf(invert(conditionFor(ins.op)), labelAt[code[pc + 1].arg]);
+                    pc++;
+                } else {
+                    a.setFlag(conditionFor(ins.op));
+                    a.store(RAX, STACK, stackSlot(d - 2));
+                }
+                break;
+
+            case OpCode::JUMP:
+                a.jump(labelAt[ins.arg]);
+                break;
+
+            case OpCode::LOOP:
+                emitBackEdge(a, labelAt[ins.arg], errorLabel);
+                break;
+
+            case OpCode::JUMP_IF_FALSE:
+                a.load(RAX, STACK, stackSlot(d - 1));
+                a.test(RAX);
+                a.jumpIf(CC_E, labelAt[ins.arg]);
+                break;
+
+            case OpCode::FOR_TEST:
+                {
+                    const LoopSpec& loop = chunk.loops[ins.arg];
+                    a.load(RAX, VARS, 4 * loop.slot);
+                    if (loop.boundIsSlot) a.memory({0x3B}, RAX, VARS, 4 * loop.bound);
+                    else a.cmpEaxImm(loop.bound);
+                    a.jumpIf(invert(conditionFor(loop.compare)), labelAt[loop.exit]);
+                    break;
+                }
+
+            case OpCode::FOR_NEXT:
+                {
+                    const LoopSpec& loop = chunk.loops[ins.arg];
+                    a.addImm(VARS, 4 * loop.slot, loop.step);
+                    emitBackEdge(a, labelAt[loop.test], errorLabel);
+                    break;
+                }
+
+            case OpCode::PRINT:
+                a.load(ARG1, STACK, stackSlot(d - 1));
+                emitCallback(a, reinterpret_cast<const void*>(&nativePrint), errorLabel);
+                break;
+
+            case OpCode::PRINT_STR:
+                a.movImm(ARG1, ins.arg);
+                emitCallback(a, reinterpret_cast<const void*>(&nativePrintString), errorLabel);
+                break;
+
+            case OpCode::VOWEL_CHECK:
+                a.movImm(ARG1, ins.arg);
+                emitCallback(a, reinterpret_cast<const void*>(&nativeVowelCheck), errorLabel);
+                break;
+
+            case OpCode::FAIL:
+                a.storeImm(CONTEXT, offsetof(NativeContext, failIndex), ins.arg);
+                a.movImm(RAX, NATIVE_FAIL);
+                a.jump(exitLabel);
+                break;
+
+            case OpCode::HALT:
+                a.movImm(RAX, NATIVE_HALT);
+                a.jump(exitLabel);
+                break;
+        }
+    }
+    a.bind(labelAt[n]);
+
+    a.bind(divZeroLabel);
+    a.movImm(RAX, NATIVE_DIV_ZERO);
+    a.jump(exitLabel);
+
+    a.bind(overflowLabel);
+    a.movImm(RAX, NATIVE_OVERFLOW);
+    a.jump(exitLabel);
+
+    a.bind(errorLabel);
+    a.movImm(RAX, NATIVE_ERROR);
+
+    a.bind(exitLabel);
+    if (SHADOW_SPACE) { a.byte(0x48); a.byte(0x83); a.byte(0xC4); a.byte(SHADOW_SPACE); }  // add rsp
+    a.pop(R15); a.pop(R14); a.pop(R13); a.pop(R12); a.pop(RBX);
+    a.byte(0xC3);  // ret
+
+    return a.finish();
+}
+
+// Page-aligned memory that is writable while code is copied in, then
+// read-only and executable
+class ExecutableMemory {
+    void* memory = nullptr;
+    size_t size = 0;
+
+public:
+    ExecutableMemory() {}
+    ExecutableMemory(const ExecutableMemory&) = delete;
+    ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+    ~ExecutableMemory() {
+        if (!memory) return;
+#ifdef _WIN32
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, size);
+#endif
+    }
+
+    bool load(const std::vector<uint8_t>& code) {
+        size = code.size();
+#ifdef _WIN32
+        memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!memory) return false;
+        std::memcpy(memory, code.data(), size);
+        DWORD previous;
+        if (!VirtualProtect(memory, size, PAGE_EXECUTE_READ, &previous)) return false;
+        FlushInstructionCache(GetCurrentProcess(), memory, size);
+#else
+        void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) return false;
+        memory = block;
+        std::memcpy(memory, code.data(), size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) return false;
+#endif
+        return true;
+    }
+
+    NativeEntry entry() const {
+        NativeEntry function;
+        std::memcpy(&function, &memory, sizeof(function));
+        return function;
+    }
+};
+
+}  // namespace
+
+bool Jit::run(const ChunkView& chunk) {
+    Assembler assembler;
+    if (!translate(chunk, assembler)) return false;
+    ExecutableMemory native;
+    if (!native.load(assembler.code())) return false;
+
+    std::vector<int> slots(chunk.slotCount, 0);
+    for (size_t i = 0; i < chunk.nameCount; i++) {
+        auto it = variables.find(chunk.name(i));
+        if (it != variables.end()) slots[i] = it->second;
+    }
+
+    budget.start(limits);
+    // Temporaries are the compiler's doing, so only variables count
+    budget.chargeMemory(chunk.nameCount * sizeof(int));
+
+    std::vector<int> stack(chunk.maxStack + 1);
+    std::exception_ptr error;
+    NativeContext context = {0, out, &budget, &chunk, &error};
+    int status = native.entry()(slots.data(), stack.data(), &context, budget.countdownAddress());
+
+    // Keep whatever state the program reached, as the VM does
+    for (size_t i = 0; i < chunk.nameCount; i++) {
+        variables[chunk.name(i)] = slots[i];
+    }
+    out->flush();
+
+    switch (status) {
+        case NATIVE_ERROR:
+            std::rethrow_exception(error);
+        case NATIVE_FAIL:
+            throw std::runtime_error(chunk.string(context.failIndex).str());
+        case NATIVE_DIV_ZERO:
+            throw std::runtime_error("Division by zero");
+        case NATIVE_OVERFLOW:
+            throw std::runtime_error("Integer overflow");
+        default:
+            return true;
+    }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include "bytecode.h"
+#include "exec_limits.h"
+#include "output.h"
+#include <unordered_map>
+#include <string>
+
+// Optional native tier. Translates a whole Chunk into x86-64 machine code
+// in executable memory and runs it. The generated code follows the VM
+// instruction for instruction and calls back into the runtime for
+// লেখ, স্বরবর্ণচেক and step/time checkpoints. A zero divisor makes the
+// native code return early, and run() then throws "Division by zero" as
+// the VM would. Callbacks never let an exception cross native frames.
+//
+// run() returns false without executing anything when native code is not
+// available (not x86-64, or the OS refuses executable memory), so callers
+// can fall back to the VM.
+class Jit {
+    std::unordered_map<std::string, int> variables;
+    OutputSink* out;
+    ExecutionLimits limits;
+    ExecutionBudget budget;
+
+public:
+    Jit() : out(&standardOutput()) {}
+    void setOutput(OutputSink& sink) { out = &sink; }
+    void setLimits(const ExecutionLimits& newLimits) { limits = newLimits; }
+
+    bool run(const ChunkView& chunk);
+    bool run(const Chunk& chunk) { return run(chunk.view()); }
+    void setVariable(const std::string& name, int value);
+    int getVariable(const std::string& name);
+};
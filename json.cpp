@@ -0,0 +1,248 @@
+#include "json.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+struct JsonReader {
+    const std::string& text;
+    size_t pos = 0;
+    std::string error;
+
+    explicit JsonReader(const std::string& t) : text(t) {}
+
+    bool fail(const char* message) {
+        if (error.empty()) error = message;
+        return false;
+    }
+
+    void skipSpace() {
+        while (pos < text.size() &&
+               (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+            pos++;
+        }
+    }
+
+    static void appendUtf8(std::string& out, unsigned long cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool readHex4(unsigned long& cp) {
+        if (pos + 4 > text.size()) return fail("Bad \\u escape");
+        std::string hex = text.substr(pos, 4);
+        char* end = nullptr;
+        cp = std::strtoul(hex.c_str(), &end, 16);
+        if (end != hex.c_str() + 4) return fail("Bad \\u escape");
+        pos += 4;
+        return true;
+    }
+
+    bool readString(std::string& out) {
+        pos++;  // opening quote
+        while (pos < text.size()) {
+            char c = text[pos++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size()) break;
+            char e = text[pos++];
+            switch (e) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned long cp;
+                    if (!readHex4(cp)) return false;
+                    if (cp >= 0xD800 && cp <= 0xDBFF && pos + 1 < text.size() &&
+                        text[pos] == '\\' && text[pos + 1] == 'u') {
+                        pos += 2;
+                        unsigned long low;
+                        if (!readHex4(low)) return false;
+                        if (low >= 0xDC00 && low <= 0xDFFF) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        } else {
+                            appendUtf8(out, 0xFFFD);
+                            cp = low;
+                        }
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    return fail("Bad escape in string");
+            }
+        }
+        return fail("Unterminated string");
+    }
+
+    // Skips any value, leaving pos just past it
+    bool skipValue(int depth) {
+        if (depth > 64) return fail("Nesting too deep");
+        skipSpace();
+        if (pos >= text.size()) return fail("Expected a value");
+
+        char c = text[pos];
+        if (c == '"') {
+            std::string ignored;
+            return readString(ignored);
+        }
+        if (c == '{' || c == '[') {
+            char close = c == '{' ? '}' : ']';
+            pos++;
+            skipSpace();
+            if (pos < text.size() && text[pos] == close) {
+                pos++;
+                return true;
+            }
+            for (;;) {
+                if (c == '{') {
+                    skipSpace();
+                    if (pos >= text.size() || text[pos] != '"') return fail("Expected a key");
+                    std::string key;
+                    if (!readString(key)) return false;
+                    skipSpace();
+                    if (pos >= text.size() || text[pos] != ':') return fail("Expected ':'");
+                    pos++;
+                }
+                if (!skipValue(depth + 1)) return false;
+                skipSpace();
+                if (pos < text.size() && text[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                if (pos < text.size() && text[pos] == close) {
+                    pos++;
+                    return true;
+                }
+                return fail("Expected ',' or closing bracket");
+            }
+        }
+
+        // number, true, false, null
+        size_t start = pos;
+        while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']' &&
+               text[pos] != ' ' && text[pos] != '\t' && text[pos] != '\r' && text[pos] != '\n') {
+            pos++;
+        }
+        if (pos == start) return fail("Expected a value");
+        return true;
+    }
+};
+
+}  // namespace
+
+bool parseJsonObject(const std::string& text, JsonObject& fields, std::string& error) {
+    JsonReader reader(text);
+    reader.skipSpace();
+    if (reader.pos >= text.size() || text[reader.pos] != '{') {
+        error = "Expected a JSON object";
+        return false;
+    }
+    reader.pos++;
+    reader.skipSpace();
+
+    if (reader.pos < text.size() && text[reader.pos] == '}') {
+        reader.pos++;
+    } else {
+        for (;;) {
+            reader.skipSpace();
+            if (reader.pos >= text.size() || text[reader.pos] != '"') {
+                error = "Expected a key";
+                return false;
+            }
+            std::string key;
+            if (!reader.readString(key)) {
+                error = reader.error;
+                return false;
+            }
+            reader.skipSpace();
+            if (reader.pos >= text.size() || text[reader.pos] != ':') {
+                error = "Expected ':'";
+                return false;
+            }
+            reader.pos++;
+            reader.skipSpace();
+
+            JsonField field;
+            size_t start = reader.pos;
+            if (start < text.size() && text[start] == '"') {
+                field.isString = true;
+                if (!reader.readString(field.value)) {
+                    error = reader.error;
+                    return false;
+                }
+            } else if (!reader.skipValue(0)) {
+                error = reader.error;
+                return false;
+            }
+            field.raw = text.substr(start, reader.pos - start);
+            if (!field.isString) field.value = field.raw;
+            fields[key] = field;
+
+            reader.skipSpace();
+            if (reader.pos < text.size() && text[reader.pos] == ',') {
+                reader.pos++;
+                continue;
+            }
+            if (reader.pos < text.size() && text[reader.pos] == '}') {
+                reader.pos++;
+                break;
+            }
+            error = "Expected ',' or '}'";
+            return false;
+        }
+    }
+
+    reader.skipSpace();
+    if (reader.pos != text.size()) {
+        error = "Trailing characters after object";
+        return false;
+    }
+    return true;
+}
+
+std::string jsonQuote(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 2);
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
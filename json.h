@@ -0,0 +1,20 @@
+#pragma once
+#include <map>
+#include <string>
+
+// Just enough JSON for the request/response framing of server mode: one
+// flat object per line. Nested objects and arrays are accepted and kept
+// as raw text.
+struct JsonField {
+    bool isString = false;
+    std::string value;  // decoded string, or the literal text otherwise
+    std::string raw;    // exact JSON text of the value, for echoing back
+};
+
+typedef std::map<std::string, JsonField> JsonObject;
+
+// Parses a single JSON object. Returns false and sets error on bad input.
+bool parseJsonObject(const std::string& text, JsonObject& fields, std::string& error);
+
+// Encodes s as a JSON string literal, quotes included
+std::string jsonQuote(const std::string& s);
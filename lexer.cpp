@@ -1,12 +1,109 @@
 #include "lexer.h"
+#include "scanner.h"
+#include "bangla_text.h"
 #include <cctype>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
 
-void Lexer::skipWhitespace() {
-    while (pos < input.length() && std::isspace(static_cast<unsigned char>(input[pos]))) {
-        pos++;
+// Map ACTUAL BANGLA words to tokens. The table is indexed by a perfect
+// hash of the UTF-8 spelling,
+//     (length + 21 * byte[2] + byte[length - 1]) % 64,
+// which has no collisions for this keyword set. byte[2] is the last byte
+// of the first code point and byte[length - 1] of the last one. When
+// adding a keyword, re-pick the multiplier (and table size if needed) so
+// every entry still lands in its own bucket.
+struct KeywordEntry {
+    const char* text;
+    uint8_t length;
+    TokenType type;
+    int value;
+};
+
+static const KeywordEntry keywordTable[64] = {
+    {"স্বরবর্ণসংখ্যা", 42, TokenType::BORNO, static_cast<int>(TextQuery::VOWEL_COUNT)},
+    {"ব্যঞ্জনসংখ্যা", 39, TokenType::BORNO, static_cast<int>(TextQuery::CONSONANT_COUNT)},
+    {"বিয়োগ", 15, TokenType::BIYOG, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"০", 3, TokenType::NUM, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"৩", 3, TokenType::NUM, 3},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"৬", 3, TokenType::NUM, 6},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"৯", 3, TokenType::NUM, 9},
+    {"স্বরবর্ণচেক", 33, TokenType::SHOROBORNO, 0},
+    {"গুণ", 9, TokenType::GUN, 0},
+    {"যতক্ষণ", 18, TokenType::JOTOKKHON, 0},
+    {"ভাগ", 9, TokenType::BHAG, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"এক", 6, TokenType::NUM, 1},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"পাঁচ", 12, TokenType::NUM, 5},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"চার", 9, TokenType::NUM, 4},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"১", 3, TokenType::NUM, 1},
+    {"নাহলে", 15, TokenType::NAHOLE, 0},
+    {"৪", 3, TokenType::NUM, 4},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"৭", 3, TokenType::NUM, 7},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"যদি", 9, TokenType::JODI, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"তিন", 9, TokenType::NUM, 3},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"স্বরবর্ণঅবস্থান", 45, TokenType::BORNO, static_cast<int>(TextQuery::FIRST_VOWEL)},
+    {"দুই", 9, TokenType::NUM, 2},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"২", 3, TokenType::NUM, 2},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"৫", 3, TokenType::NUM, 5},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"৮", 3, TokenType::NUM, 8},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {"লেখ", 9, TokenType::LEKHO, 0},
+    {"প্রতিবার", 24, TokenType::PROTIBAR, 0},
+    {"যোগ", 9, TokenType::JOG, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0},
+    {nullptr, 0, TokenType::INVALID, 0}
+};
+
+static const KeywordEntry* findKeyword(const char* word, size_t length) {
+    // Every keyword is Bangla, 1 to 15 code points of 3 bytes each
+    if (length < 3 || length > 45 || static_cast<unsigned char>(word[0]) != 0xE0) {
+        return nullptr;
+    }
+    
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(word);
+    const KeywordEntry& entry = keywordTable[(length + 21 * bytes[2] + bytes[length - 1]) % 64];
+    if (entry.length == length && std::memcmp(entry.text, word, length) == 0) {
+        return &entry;
     }
+    return nullptr;
+}
+
+void Lexer::skipWhitespace() {
+    pos = skipSpaces(input.data(), pos, input.length());
 }
 
 bool Lexer::startsWith(const std::string& prefix) {
@@ -17,96 +114,35 @@ bool Lexer::startsWith(const std::string& prefix) {
 Token Lexer::readBanglaWord() {
     size_t start = pos;
     
-    // Read until whitespace or special character
-    while (pos < input.length()) {
-        unsigned char c = static_cast<unsigned char>(input[pos]);
-        
-        // Stop at whitespace or special characters
-        if (std::isspace(c) || 
-            c == '(' || c == ')' || c == '{' || c == '}' ||
-            c == ';' || c == '"' || c == '+' || c == '-' ||
-            c == '*' || c == '/' || c == '=' || c == '!' ||
-            c == '<' || c == '>') {
-            break;
-        }
-        
-        // Skip Bangla/Unicode characters (3 bytes each)
-        if (c >= 0xE0) { // UTF-8 multi-byte start
-            if (c == 0xE0 && pos + 2 < input.length()) {
-                pos += 3; // Skip UTF-8 character
-            } else {
-                pos++; // Safety
-            }
-        } else {
-            pos++; // ASCII
-        }
-    }
+    // Read until whitespace or special character. Delimiters are ASCII and
+    // never occur inside a UTF-8 sequence, so this is a plain byte search.
+    pos = findDelimiter(input.data(), pos, input.length());
     
-    std::string word = input.substr(start, pos - start);
+    const char* word = input.data() + start;
+    size_t length = pos - start;
     
-    // Map ACTUAL BANGLA words to tokens
-    static std::map<std::string, TokenType> banglaKeywords = {
-        // Numbers (Bangla)
-        {"এক", TokenType::NUM},
-        {"দুই", TokenType::NUM},
-        {"তিন", TokenType::NUM},
-        {"চার", TokenType::NUM},
-        {"পাঁচ", TokenType::NUM},
-        
-        // Arithmetic (Bangla)
-        {"যোগ", TokenType::JOG},
-        {"বিয়োগ", TokenType::BIYOG},
-        {"গুণ", TokenType::GUN},
-        {"ভাগ", TokenType::BHAG},
-        
-        // Control flow (Bangla)
-        {"যদি", TokenType::JODI},
-        {"নাহলে", TokenType::NAHOLE},
-        {"যতক্ষণ", TokenType::JOTOKKHON},
-        {"প্রতিবার", TokenType::PROTIBAR},
-        
-        // Functions (Bangla)
-        {"লেখ", TokenType::LEKHO},
-        {"স্বরবর্ণচেক", TokenType::SHOROBORNO}
-    };
+    uint32_t offset = static_cast<uint32_t>(start);
+    uint32_t size = static_cast<uint32_t>(length);
     
-    // Check for Bangla keywords
-    auto it = banglaKeywords.find(word);
-    if (it != banglaKeywords.end()) {
-        // Set numeric values for Bangla numbers
-        if (word == "এক") return Token(TokenType::NUM, 1);
-        else if (word == "দুই") return Token(TokenType::NUM, 2);
-        else if (word == "তিন") return Token(TokenType::NUM, 3);
-        else if (word == "চার") return Token(TokenType::NUM, 4);
-        else if (word == "পাঁচ") return Token(TokenType::NUM, 5);
-        else return Token(it->second);
+    // Bangla keywords, number words and digits come back in one probe
+    const KeywordEntry* keyword = findKeyword(word, length);
+    if (keyword) {
+        return Token(keyword->type, keyword->value, offset, size);
     }
-
-    // Check for Bangla digits
-    if (word == "০") return Token(TokenType::NUM, 0);
-    else if (word == "১") return Token(TokenType::NUM, 1);
-    else if (word == "২") return Token(TokenType::NUM, 2);
-    else if (word == "৩") return Token(TokenType::NUM, 3);
-    else if (word == "৪") return Token(TokenType::NUM, 4);
-    else if (word == "৫") return Token(TokenType::NUM, 5);
-    else if (word == "৬") return Token(TokenType::NUM, 6);
-    else if (word == "৭") return Token(TokenType::NUM, 7);
-    else if (word == "৮") return Token(TokenType::NUM, 8);
-    else if (word == "৯") return Token(TokenType::NUM, 9);
     
     // Check if it's a regular number
     bool isNumber = true;
-    for (char c : word) {
-        if (!std::isdigit(static_cast<unsigned char>(c))) {
+    for (size_t i = 0; i < length; i++) {
+        if (!std::isdigit(static_cast<unsigned char>(word[i]))) {
             isNumber = false;
             break;
         }
     }
     if (isNumber) {
-        return Token(TokenType::NUM, std::stoi(word));
+        return Token(TokenType::NUM, std::stoi(std::string(word, length)), offset, size);
     }
     
-    return Token(TokenType::IDENTIFIER, word);
+    return Token(TokenType::IDENTIFIER, symbolTable.intern(word, length), offset, size);
 }
 
 Token Lexer::readNumber() {
@@ -115,79 +151,117 @@ Token Lexer::readNumber() {
         pos++;
     }
     std::string numStr = input.substr(start, pos - start);
-    return Token(TokenType::NUM, std::stoi(numStr));
+    Token token(TokenType::NUM, 0, static_cast<uint32_t>(start), static_cast<uint32_t>(pos - start));
+    try {
+        token.value = std::stoi(numStr);
+    } catch (const std::out_of_range&) {
+        SourcePosition at = position(start);
+        throw SyntaxError(Diagnostic{"Number out of range", token.offset, at.line, at.column});
+    }
+    return token;
 }
 
 Token Lexer::readString() {
     pos++; // Skip opening quote
     size_t start = pos;
-    while (pos < input.length() && input[pos] != '"') {
-        pos++;
-    }
-    std::string str = input.substr(start, pos - start);
+    const void* quote = std::memchr(input.data() + pos, '"', input.length() - pos);
+    pos = quote ? static_cast<const char*>(quote) - input.data() : input.length();
+    Token token(TokenType::STRING, 0, static_cast<uint32_t>(start),
+                static_cast<uint32_t>(pos - start));
     pos++; // Skip closing quote
-    return Token(TokenType::STRING, str);
+    return token;
+}
+
+Token Lexer::readSymbol(TokenType type, size_t length) {
+    Token token(type, 0, static_cast<uint32_t>(pos), static_cast<uint32_t>(length));
+    pos += length;
+    return token;
+}
+
+bool Lexer::nextToken(Token& token) {
+    skipWhitespace();
+    if (pos >= input.length()) return false;
+
+    unsigned char current = static_cast<unsigned char>(input[pos]);
+
+    if (current == '"') {
+        token = readString();
+    }
+    else if (std::isdigit(current)) {
+        token = readNumber();
+    }
+    else if (std::isalpha(current) ||
+             (current >= 0x80 &&
+              utf8SequenceLength(reinterpret_cast<const unsigned char*>(input.data()) + pos,
+                                 input.length() - pos) > 1)) {
+        // Bangla (or any other well-formed UTF-8) or English word
+        token = readBanglaWord();
+    }
+    else {
+        // Handle symbols
+        switch (current) {
+            case '+': token = readSymbol(TokenType::PLUS, 1); break;
+            case '-': token = readSymbol(TokenType::MINUS, 1); break;
+            case '*': token = readSymbol(TokenType::MUL, 1); break;
+            case '/': token = readSymbol(TokenType::DIV, 1); break;
+            case '(': token = readSymbol(TokenType::LPAREN, 1); break;
+            case ')': token = readSymbol(TokenType::RPAREN, 1); break;
+            case '{': token = readSymbol(TokenType::LBRACE, 1); break;
+            case '}': token = readSymbol(TokenType::RBRACE, 1); break;
+            case ';': token = readSymbol(TokenType::SEMICOLON, 1); break;
+            case '=':
+                if (pos + 1 < input.length() && input[pos + 1] == '=') {
+                    token = readSymbol(TokenType::EQ, 2);
+                } else {
+                    token = readSymbol(TokenType::ASSIGN, 1);
+                }
+                break;
+            case '!': 
+                if (pos + 1 < input.length() && input[pos + 1] == '=') {
+                    token = readSymbol(TokenType::NEQ, 2);
+                } else {
+                    token = readSymbol(TokenType::INVALID, 1);
+                }
+                break;
+            case '<': token = readSymbol(TokenType::LT, 1); break;
+            case '>': token = readSymbol(TokenType::GT, 1); break;
+            default: 
+                token = readSymbol(TokenType::INVALID, 1);
+                break;
+        }
+    }
+    return true;
+}
+
+SourcePosition Lexer::position(size_t offset) {
+    if (lineStarts.empty()) {
+        lineStarts.push_back(0);
+        const char* data = input.data();
+        const char* end = data + input.length();
+        for (const char* p = data; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))); p++) {
+            lineStarts.push_back(static_cast<uint32_t>(p + 1 - data));
+        }
+    }
+    offset = std::min(offset, input.length());
+    size_t line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin();
+
+    uint32_t column = 1;
+    for (size_t i = lineStarts[line - 1]; i < offset; i++) {
+        if ((static_cast<unsigned char>(input[i]) & 0xC0) != 0x80) column++;
+    }
+    SourcePosition at = {static_cast<uint32_t>(line), column};
+    return at;
 }
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
+    tokens.reserve(input.length() / 4 + 1);
     
-    while (pos < input.length()) {
-        skipWhitespace();
-        if (pos >= input.length()) break;
-        
-        unsigned char current = static_cast<unsigned char>(input[pos]);
-        
-        if (current == '"') {
-            tokens.push_back(readString());
-        }
-        else if (std::isdigit(current)) {
-            tokens.push_back(readNumber());
-        }
-        else if (current >= 0xE0 || std::isalpha(current)) {
-            // Bangla or English word
-            tokens.push_back(readBanglaWord());
-        }
-        else {
-            // Handle symbols
-            switch (current) {
-                case '+': tokens.push_back(Token(TokenType::PLUS)); pos++; break;
-                case '-': tokens.push_back(Token(TokenType::MINUS)); pos++; break;
-                case '*': tokens.push_back(Token(TokenType::MUL)); pos++; break;
-                case '/': tokens.push_back(Token(TokenType::DIV)); pos++; break;
-                case '(': tokens.push_back(Token(TokenType::LPAREN)); pos++; break;
-                case ')': tokens.push_back(Token(TokenType::RPAREN)); pos++; break;
-                case '{': tokens.push_back(Token(TokenType::LBRACE)); pos++; break;
-                case '}': tokens.push_back(Token(TokenType::RBRACE)); pos++; break;
-                case ';': tokens.push_back(Token(TokenType::SEMICOLON)); pos++; break;
-                case '=':
-                    if (pos + 1 < input.length() && input[pos + 1] == '=') {
-                        tokens.push_back(Token(TokenType::EQ));
-                        pos += 2;
-                    } else {
-                        tokens.push_back(Token(TokenType::ASSIGN));
-                        pos++;
-                    }
-                    break;
-                case '!': 
-                    if (pos + 1 < input.length() && input[pos + 1] == '=') {
-                        tokens.push_back(Token(TokenType::NEQ));
-                        pos += 2;
-                    } else {
-                        tokens.push_back(Token(TokenType::INVALID));
-                        pos++;
-                    }
-                    break;
-                case '<': tokens.push_back(Token(TokenType::LT)); pos++; break;
-                case '>': tokens.push_back(Token(TokenType::GT)); pos++; break;
-                default: 
-                    tokens.push_back(Token(TokenType::INVALID));
-                    pos++;
-                    break;
-            }
-        }
+    Token token(TokenType::END);
+    while (nextToken(token)) {
+        tokens.push_back(token);
     }
     
-    tokens.push_back(Token(TokenType::END));
+    tokens.push_back(Token(TokenType::END, 0, static_cast<uint32_t>(input.length()), 0));
     return tokens;
 }
\ No newline at end of file
@@ -1,4 +1,8 @@
 #pragma once
+#include "arena.h"
+#include "symbols.h"
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <map>
@@ -28,6 +32,7 @@ enum class TokenType {
     // Bangla Functions (actual Bangla)
     LEKHO,   // লেখ
     SHOROBORNO, // স্বরবর্ণচেক
+    BORNO,   // স্বরবর্ণসংখ্যা, ব্যঞ্জনসংখ্যা, স্বরবর্ণঅবস্থান (value is a TextQuery)
     
     // Comparison
     EQ, NEQ, LT, GT,
@@ -39,26 +44,76 @@ enum class TokenType {
     STRING, IDENTIFIER
 };
 
+// Tokens do not own any text: they point into the source by offset and
+// length (for strings, the part between the quotes). An IDENTIFIER's value
+// is its id in the lexer's symbol table. Line and column come from
+// Lexer::position, so tokens stay 16 bytes.
 struct Token {
     TokenType type;
     int value;
-    std::string strValue;
+    uint32_t offset;
+    uint32_t length;
     
-    Token(TokenType t, int v = 0) : type(t), value(v) {}
-    Token(TokenType t, std::string s) : type(t), strValue(s) {}
+    Token(TokenType t, int v = 0, uint32_t off = 0, uint32_t len = 0)
+        : type(t), value(v), offset(off), length(len) {}
 };
 
+// 1-based; column counts code points
+struct SourcePosition {
+    uint32_t line;
+    uint32_t column;
+};
+
+// One syntax error and where it was found
+struct Diagnostic {
+    std::string message;
+    uint32_t offset;
+    uint32_t line;
+    uint32_t column;
+};
+
+// Thrown by the lexer and parser; what() is the bare message
+class SyntaxError : public std::runtime_error {
+public:
+    Diagnostic diagnostic;
+
+    explicit SyntaxError(const Diagnostic& d) : std::runtime_error(d.message), diagnostic(d) {}
+};
+
+// Scans the caller's string in place; it must outlive the lexer and the
+// tokens it produces.
 class Lexer {
-    std::string input;
+    const std::string& input;
     size_t pos = 0;
+    SymbolTable symbolTable;
+    std::vector<uint32_t> lineStarts;  // built by the first position() call
     
     void skipWhitespace();
     Token readBanglaWord();
     Token readNumber();
     Token readString();
+    Token readSymbol(TokenType type, size_t length);
     bool startsWith(const std::string& prefix);
     
 public:
     Lexer(const std::string& in) : input(in) {}
     std::vector<Token> tokenize();
+
+    // One token at a time from the current position, for re-lexing part
+    // of an edited source (see incremental.h). Returns false at the end.
+    bool nextToken(Token& token);
+    // Continues from offset; the source may have been edited meanwhile
+    void seek(size_t offset) {
+        pos = offset;
+        lineStarts.clear();
+    }
+
+    // Line and column of a byte offset, such as a token's. Lines are only
+    // indexed when first asked for, so lexing pays nothing for this.
+    SourcePosition position(size_t offset);
+    
+    StringRef text(const Token& token) const {
+        return StringRef(input.data() + token.offset, token.length);
+    }
+    SymbolTable& symbols() { return symbolTable; }
 };
\ No newline at end of file
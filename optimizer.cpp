@@ -0,0 +1,254 @@
+#include "optimizer.h"
+#include "bangla_text.h"
+#include <climits>
+
+// Value of a literal operand: numbers, and strings (which evaluate to their length)
+bool Optimizer::constantValue(const ASTNode* node, int& value) {
+    if (!node) return false;
+    if (node->type == TokenType::NUM) {
+        value = node->value;
+        return true;
+    }
+    if (node->type == TokenType::STRING) {
+        value = static_cast<int>(node->text.length());
+        return true;
+    }
+    return false;
+}
+
+// True if evaluating node as a value can neither throw nor change a variable
+bool Optimizer::isPure(const ASTNode* root) {
+    unchecked.clear();
+    unchecked.push_back(root);
+
+    while (!unchecked.empty()) {
+        const ASTNode* node = unchecked.back();
+        unchecked.pop_back();
+        if (!node) continue;
+
+        switch (node->type) {
+            case TokenType::NUM:
+            case TokenType::STRING:
+            case TokenType::IDENTIFIER:
+            case TokenType::BORNO:
+                break;
+
+            case TokenType::PLUS: case TokenType::JOG:
+            case TokenType::MINUS: case TokenType::BIYOG:
+            case TokenType::MUL: case TokenType::GUN:
+                unchecked.push_back(node->left);
+                unchecked.push_back(node->right);
+                break;
+
+            case TokenType::DIV: case TokenType::BHAG:
+                {
+                    // Safe only for a known divisor that cannot trap
+                    int divisor;
+                    if (!constantValue(node->right, divisor) || divisor == 0 || divisor == -1) return false;
+                    unchecked.push_back(node->left);
+                    break;
+                }
+
+            default:
+                // Assignments write, comparisons throw when used as a value
+                return false;
+        }
+    }
+    return true;
+}
+
+void Optimizer::makeConstant(ASTNode* node, int value) {
+    node->type = TokenType::NUM;
+    node->value = value;
+    node->text = StringRef();
+    node->left = nullptr;
+    node->right = nullptr;
+}
+
+// Folds bottom-up from a work list of links to nodes, so deep expressions
+// use no native stack. An operator is taken off a second time once its
+// operands are folded, and its link then gets what it folds to.
+ASTNode* Optimizer::foldExpression(ASTNode* root) {
+    folds.clear();
+    folds.push_back(Fold{&root, false});
+
+    while (!folds.empty()) {
+        Fold item = folds.back();
+        folds.pop_back();
+        ASTNode* node = *item.link;
+        if (!node) continue;
+
+        switch (node->type) {
+            case TokenType::ASSIGN:
+                if (!item.operandsDone) folds.push_back(Fold{&node->right, false});
+                break;
+
+            case TokenType::BORNO:
+                // Text built-ins only ever see a literal
+                makeConstant(node, runTextQuery(node->value, node->left->text.data, node->left->text.length()));
+                break;
+
+            case TokenType::PLUS: case TokenType::JOG:
+            case TokenType::MINUS: case TokenType::BIYOG:
+            case TokenType::MUL: case TokenType::GUN:
+            case TokenType::DIV: case TokenType::BHAG:
+                if (item.operandsDone) {
+                    *item.link = foldOperator(node);
+                } else {
+                    folds.push_back(Fold{item.link, true});
+                    folds.push_back(Fold{&node->right, false});
+                    folds.push_back(Fold{&node->left, false});
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+    return root;
+}
+
+// An arithmetic node whose operands are already folded
+ASTNode* Optimizer::foldOperator(ASTNode* node) {
+    int a = 0, b = 0;
+    bool leftConst = constantValue(node->left, a);
+    bool rightConst = constantValue(node->right, b);
+    // Fold with wrap-around, which is what the engines do at run time
+    unsigned int ua = static_cast<unsigned int>(a), ub = static_cast<unsigned int>(b);
+
+    switch (node->type) {
+        case TokenType::PLUS:
+        case TokenType::JOG: // যোগ
+            if (leftConst && rightConst) makeConstant(node, static_cast<int>(ua + ub));
+            else if (leftConst && a == 0) return node->right;
+            else if (rightConst && b == 0) return node->left;
+            return node;
+
+        case TokenType::MINUS:
+        case TokenType::BIYOG: // বিয়োগ
+            if (leftConst && rightConst) makeConstant(node, static_cast<int>(ua - ub));
+            else if (rightConst && b == 0) return node->left;
+            return node;
+
+        case TokenType::MUL:
+        case TokenType::GUN: // গুণ
+            if (leftConst && rightConst) makeConstant(node, static_cast<int>(ua * ub));
+            else if (leftConst && a == 1) return node->right;
+            else if (rightConst && b == 1) return node->left;
+            else if ((leftConst && a == 0 && isPure(node->right)) ||
+                     (rightConst && b == 0 && isPure(node->left))) {
+                makeConstant(node, 0);
+            }
+            return node;
+
+        default: // ভাগ
+            // A zero divisor stays in the tree so the error is raised when
+            // the program gets there, after any output before it
+            if (!rightConst || b == 0) return node;
+            if (leftConst && !(a == INT_MIN && b == -1)) makeConstant(node, a / b);
+            else if (b == 1) return node->left;
+            return node;
+    }
+}
+
+int Optimizer::foldCondition(ASTNode* node) {
+    if (!node) return 0;
+
+    // Both operands are evaluated as values whatever the node is
+    node->left = foldExpression(node->left);
+    node->right = foldExpression(node->right);
+
+    int a = 0, b = 0;
+    switch (node->type) {
+        case TokenType::EQ:
+        case TokenType::NEQ:
+        case TokenType::LT:
+        case TokenType::GT:
+            if (!constantValue(node->left, a) || !constantValue(node->right, b)) return -1;
+            if (node->type == TokenType::EQ) return a == b;
+            if (node->type == TokenType::NEQ) return a != b;
+            if (node->type == TokenType::LT) return a < b;
+            return a > b;
+
+        default:
+            // Not a comparison: always false once the operands have run
+            return isPure(node->left) && isPure(node->right) ? 0 : -1;
+    }
+}
+
+// Evaluator runs the children of a যদি/যতক্ষণ body, whatever the body node
+// is; this gives the same statements as a standalone block
+ASTNode* Optimizer::asBlock(ASTNode* body) {
+    if (!body || body->type == TokenType::LBRACE) return body;
+    ASTNode* block = program->arena.make<ASTNode>(TokenType::LBRACE, 0, StringRef());
+    block->children = body->children;
+    return block;
+}
+
+ASTNode* Optimizer::optimizeStatement(ASTNode* node) {
+    if (!node) return node;
+
+    switch (node->type) {
+        case TokenType::LEKHO:
+            node->left = foldExpression(node->left);
+            return node;
+
+        case TokenType::SHOROBORNO:
+            return node;
+
+        case TokenType::JODI: // যদি (if)
+            {
+                int state = foldCondition(node->left);
+                if (node->right) optimizeList(node->right->children);
+                if (node->extra) optimizeList(node->extra->children);
+                if (state == 1) return asBlock(node->right);
+                if (state == 0) return asBlock(node->extra);
+                return node;
+            }
+
+        case TokenType::JOTOKKHON: // যতক্ষণ (while)
+            {
+                int state = foldCondition(node->left);
+                if (state == 0) return nullptr;
+                if (node->right) optimizeList(node->right->children);
+                return node;
+            }
+
+        case TokenType::PROTIBAR: // প্রতিবার (for)
+            {
+                node->left = foldExpression(node->left);
+                int state = foldCondition(node->right);
+                // With a false condition only the initializer ever runs
+                if (state == 0) return node->left;
+                node->extra = foldExpression(node->extra);
+                optimizeList(node->children);
+                return node;
+            }
+
+        case TokenType::LBRACE:
+            optimizeList(node->children);
+            return node;
+
+        default:
+            // Expression statement
+            return foldExpression(node);
+    }
+}
+
+void Optimizer::optimizeList(NodeList& list) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < list.count; i++) {
+        ASTNode* child = optimizeStatement(list.items[i]);
+        if (!child) continue;
+        if (child->type == TokenType::LBRACE && child->children.empty()) continue;
+        if (isPure(child)) continue;  // a value nobody reads
+        list.items[kept++] = child;
+    }
+    list.count = kept;
+}
+
+void Optimizer::optimize(Program& target) {
+    program = &target;
+    if (target.root) optimizeList(target.root->children);
+    program = nullptr;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "parser.h"
+#include <vector>
+
+// Rewrites a parsed program in place before it is executed: folds constant
+// arithmetic, drops identities such as x গুণ ১, and removes যদি/নাহলে arms and
+// loops whose condition is known. Only rewrites that Evaluator cannot tell
+// apart are made, so output, errors (including when "Division by zero" is
+// raised) and step counts stay the same.
+class Optimizer {
+    Program* program = nullptr;
+
+    // Work lists, so expressions of any depth are walked without recursion
+    struct Fold {
+        ASTNode** link;  // where the node hangs
+        bool operandsDone;
+    };
+    std::vector<Fold> folds;
+    std::vector<const ASTNode*> unchecked;
+
+    static bool constantValue(const ASTNode* node, int& value);
+    bool isPure(const ASTNode* root);
+    static void makeConstant(ASTNode* node, int value);
+
+    ASTNode* foldExpression(ASTNode* root);
+    ASTNode* foldOperator(ASTNode* node);
+    int foldCondition(ASTNode* node);  // 1 true, 0 false, -1 unknown
+    ASTNode* asBlock(ASTNode* body);
+
+    ASTNode* optimizeStatement(ASTNode* node);
+    void optimizeList(NodeList& list);
+
+public:
+    void optimize(Program& target);
+};
@@ -0,0 +1,102 @@
+#include "output.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#define BANGLA_WRITE _write
+#else
+#include <unistd.h>
+#define BANGLA_WRITE ::write
+#endif
+
+static const char PRINT_PREFIX[] = "লেখ: ";
+static const char VOWEL_PREFIX[] = "স্বরবর্ণ আছে: ";
+static const char YES[] = "হ্যাঁ";
+static const char NO[] = "না";
+
+OutputSink& standardOutput() {
+    static StreamSink sink(std::cout);
+    return sink;
+}
+
+void RingBufferSink::write(const char* data, size_t size) {
+    size_t capacity = ring.size();
+    if (size >= capacity) {
+        // Only the last `capacity` bytes survive
+        dropped += stored + size - capacity;
+        std::memcpy(ring.data(), data + size - capacity, capacity);
+        head = 0;
+        stored = capacity;
+        return;
+    }
+
+    size_t overflow = stored + size > capacity ? stored + size - capacity : 0;
+    dropped += overflow;
+    stored += size - overflow;
+
+    size_t first = capacity - head < size ? capacity - head : size;
+    std::memcpy(ring.data() + head, data, first);
+    std::memcpy(ring.data(), data + first, size - first);
+    head = (head + size) % capacity;
+}
+
+std::string RingBufferSink::str() const {
+    size_t capacity = ring.size();
+    size_t start = (head + capacity - stored) % capacity;
+    std::string out;
+    out.reserve(stored);
+    for (size_t i = 0; i < stored; i++) {
+        out += ring[(start + i) % capacity];
+    }
+    return out;
+}
+
+void FdSink::drain() {
+    size_t sent = 0;
+    while (sent < buffer.size()) {
+        long n = static_cast<long>(BANGLA_WRITE(fd, buffer.data() + sent,
+                                                static_cast<unsigned>(buffer.size() - sent)));
+        if (n <= 0) break;  // reader went away; drop the rest
+        sent += static_cast<size_t>(n);
+    }
+    buffer.clear();
+}
+
+size_t printNumberLine(OutputSink& out, int value) {
+    // Prefix, sign, up to 10 digits and the newline in one write
+    char line[sizeof(PRINT_PREFIX) + 12];
+    size_t prefix = sizeof(PRINT_PREFIX) - 1;
+    std::memcpy(line, PRINT_PREFIX, prefix);
+
+    char digits[12];
+    size_t count = 0;
+    unsigned int u = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+    do {
+        digits[count++] = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u);
+
+    size_t n = prefix;
+    if (value < 0) line[n++] = '-';
+    while (count) line[n++] = digits[--count];
+    line[n++] = '\n';
+
+    out.write(line, n);
+    return n;
+}
+
+size_t printTextLine(OutputSink& out, const char* text, size_t size) {
+    out.write(PRINT_PREFIX, sizeof(PRINT_PREFIX) - 1);
+    out.write(text, size);
+    out.write("\n", 1);
+    return sizeof(PRINT_PREFIX) + size;
+}
+
+size_t printVowelLine(OutputSink& out, bool hasVowel) {
+    out.write(VOWEL_PREFIX, sizeof(VOWEL_PREFIX) - 1);
+    if (hasVowel) out.write(YES, sizeof(YES) - 1);
+    else out.write(NO, sizeof(NO) - 1);
+    out.write("\n", 1);
+    return sizeof(VOWEL_PREFIX) + (hasVowel ? sizeof(YES) : sizeof(NO)) - 1;
+}
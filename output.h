@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Where লেখ and স্বরবর্ণচেক output goes. Engines write whole lines and call
+// flush() once when the program ends (normally or with an error), so a
+// sink decides for itself when bytes actually leave the process.
+class OutputSink {
+public:
+    virtual ~OutputSink() {}
+    virtual void write(const char* data, size_t size) = 0;
+    virtual void flush() {}
+
+    void write(const std::string& s) { write(s.data(), s.size()); }
+};
+
+// Collects everything in a growable in-memory buffer
+class BufferSink : public OutputSink {
+    std::string buffer;
+
+public:
+    void write(const char* data, size_t size) override { buffer.append(data, size); }
+    const std::string& str() const { return buffer; }
+    std::string take() { std::string out; out.swap(buffer); return out; }
+};
+
+// Keeps only the most recent `capacity` bytes, for runaway programs whose
+// tail is all anyone will read
+class RingBufferSink : public OutputSink {
+    std::vector<char> ring;
+    size_t head = 0;     // next write position
+    size_t stored = 0;   // valid bytes, at most ring.size()
+    size_t dropped = 0;  // bytes overwritten so far
+
+public:
+    explicit RingBufferSink(size_t capacity) : ring(capacity ? capacity : 1) {}
+    void write(const char* data, size_t size) override;
+    std::string str() const;  // retained bytes, oldest first
+    size_t droppedBytes() const { return dropped; }
+};
+
+// Buffers output for a file descriptor and writes it in large chunks: when
+// the buffer passes `threshold` bytes and on flush()
+class FdSink : public OutputSink {
+    int fd;
+    size_t threshold;
+    std::string buffer;
+
+    void drain();
+
+public:
+    explicit FdSink(int descriptor, size_t flushThreshold = 64 * 1024)
+        : fd(descriptor), threshold(flushThreshold) {}
+    ~FdSink() override { drain(); }
+
+    void write(const char* data, size_t size) override {
+        buffer.append(data, size);
+        if (buffer.size() >= threshold) drain();
+    }
+    void flush() override { drain(); }
+};
+
+// Adapter for an existing stream such as std::cout; flushes only on flush()
+class StreamSink : public OutputSink {
+    std::ostream& stream;
+
+public:
+    explicit StreamSink(std::ostream& os) : stream(os) {}
+    void write(const char* data, size_t size) override {
+        stream.write(data, static_cast<std::streamsize>(size));
+    }
+    void flush() override { stream.flush(); }
+};
+
+// Shared sink for std::cout, the engines' default
+OutputSink& standardOutput();
+
+// Line formatting shared by the engines. Each returns the bytes written.
+size_t printNumberLine(OutputSink& out, int value);                   // লেখ: <value>
+size_t printTextLine(OutputSink& out, const char* text, size_t size);  // লেখ: <text>
+size_t printVowelLine(OutputSink& out, bool hasVowel);                // স্বরবর্ণ আছে: হ্যাঁ/না
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
@@ -6,118 +7,172 @@ void Parser::eat(TokenType type) {
     if (currentToken().type == type) {
         pos++;
     } else {
-        throw std::runtime_error("Syntax error: Unexpected token");
+        fail("Syntax error: Unexpected token");
     }
 }
 
-bool Parser::match(TokenType type) {
-    return currentToken().type == type;
+void Parser::fail(const char* message) {
+    const Token& token = currentToken();
+    SourcePosition at = lexer.position(token.offset);
+    throw SyntaxError(Diagnostic{message, token.offset, at.line, at.column});
 }
 
-bool Parser::matchAny(std::initializer_list<TokenType> types) {
-    for (auto type : types) {
-        if (match(type)) return true;
+ASTNode* Parser::newNode(const Token& token) {
+    // Only string literals keep their text; identifiers keep their slot
+    StringRef text;
+    if (token.type == TokenType::STRING) {
+        StringRef source = lexer.text(token);
+        text = program->arena.copyString(source.data, source.size);
     }
-    return false;
+    
+    return program->arena.make<ASTNode>(token.type, token.value, text);
 }
 
-ASTNode* Parser::parsePrimary() {
-    if (match(TokenType::NUM)) {
-        ASTNode* node = new ASTNode(currentToken());
-        eat(TokenType::NUM);
-        return node;
-    }
-    else if (match(TokenType::STRING)) {
-        ASTNode* node = new ASTNode(currentToken());
-        eat(TokenType::STRING);
-        return node;
-    }
-    else if (match(TokenType::IDENTIFIER)) {
-        ASTNode* node = new ASTNode(currentToken());
-        eat(TokenType::IDENTIFIER);
-        return node;
-    }
-    else if (match(TokenType::LPAREN)) {
-        eat(TokenType::LPAREN);
-        ASTNode* expr = parseExpression();
-        eat(TokenType::RPAREN);
-        return expr;
-    }
-    else {
-        throw std::runtime_error("Expected number, string, identifier, or '('");
-    }
+// Every distinct variable name has a dense slot: its id in the lexer's
+// symbol table, so identifiers arrive already resolved. Assignments to
+// something other than an identifier store under the target's text, like
+// the evaluator always did.
+int Parser::assignmentSlot(ASTNode* target) {
+    if (target->type == TokenType::IDENTIFIER) return target->slot;
+    return lexer.symbols().intern(target->text.data, target->text.size);
 }
 
-ASTNode* Parser::parseMultiplicative() {
-    ASTNode* left = parsePrimary();
-    
-    while (matchAny({TokenType::MUL, TokenType::DIV, TokenType::GUN, TokenType::BHAG})) {
-        Token op = currentToken();
-        eat(op.type);
-        ASTNode* right = parsePrimary();
-        
-        ASTNode* newNode = new ASTNode(op);
-        newNode->left = left;
-        newNode->right = right;
-        left = newNode;
-    }
-    
-    return left;
+NodeList Parser::finishList(size_t mark) {
+    NodeList list;
+    list.count = static_cast<uint32_t>(scratch.size() - mark);
+    list.items = program->arena.copyArray(scratch.data() + mark, list.count);
+    scratch.resize(mark);
+    return list;
 }
 
-ASTNode* Parser::parseAdditive() {
-    ASTNode* left = parseMultiplicative();
-    
-    while (matchAny({TokenType::PLUS, TokenType::MINUS, TokenType::JOG, TokenType::BIYOG})) {
-        Token op = currentToken();
-        eat(op.type);
-        ASTNode* right = parseMultiplicative();
-        
-        ASTNode* newNode = new ASTNode(op);
-        newNode->left = left;
-        newNode->right = right;
-        left = newNode;
-    }
-    
-    return left;
+bool Parser::match(TokenType type) {
+    return currentToken().type == type;
 }
 
-ASTNode* Parser::parseComparison() {
-    ASTNode* left = parseAdditive();
-    
-    if (matchAny({TokenType::LT, TokenType::GT, TokenType::EQ, TokenType::NEQ})) {
-        Token op = currentToken();
-        eat(op.type);
-        ASTNode* right = parseAdditive();
-        
-        ASTNode* newNode = new ASTNode(op);
-        newNode->left = left;
-        newNode->right = right;
-        left = newNode;
+// Binding power of each binary operator, indexed by TokenType; 0 for
+// tokens that cannot continue an expression. Assignment is the only
+// right-associative one, and comparisons do not chain.
+static const unsigned char PRECEDENCE[] = {
+    0, 3, 3, 4, 4,        // NUM + - * /
+    0, 0, 0, 0,           // ( ) { }
+    0, 0, 0,              // ; END INVALID
+    0,                    // BANGLA_NUM
+    3, 3, 4, 4,           // যোগ বিয়োগ গুণ ভাগ
+    0, 0, 0, 0,           // যদি নাহলে যতক্ষণ প্রতিবার
+    0, 0, 0,              // লেখ স্বরবর্ণচেক BORNO
+    2, 2, 2, 2,           // == != < >
+    1,                    // =
+    0, 0                  // STRING IDENTIFIER
+};
+static_assert(sizeof(PRECEDENCE) == static_cast<size_t>(TokenType::IDENTIFIER) + 1,
+              "PRECEDENCE needs one entry per TokenType");
+
+static const int ASSIGNMENT = 1, COMPARISON = 2;
+
+// Everything an operand can start with except (
+ASTNode* Parser::parseOperand() {
+    switch (currentToken().type) {
+        case TokenType::NUM:
+        case TokenType::STRING:
+        case TokenType::IDENTIFIER:
+            return newNode(tokens[pos++]);
+
+        case TokenType::BORNO:
+            return parseTextQuery();
+
+        default:
+            fail("Expected number, string, identifier, or '('");
     }
-    
-    return left;
 }
 
-ASTNode* Parser::parseAssignment() {
-    ASTNode* left = parseComparison();
-
-    if (match(TokenType::ASSIGN)) {
-        Token assignToken = currentToken();
-        eat(TokenType::ASSIGN);
-        ASTNode* right = parseAssignment();
+// স্বরবর্ণসংখ্যা("...") and the other text built-ins: the node keeps the
+// query in its value and the string in left
+ASTNode* Parser::parseTextQuery() {
+    ASTNode* node = newNode(currentToken());
+    eat(TokenType::BORNO);
+    eat(TokenType::LPAREN);
 
-        ASTNode* assignNode = new ASTNode(assignToken);
-        assignNode->left = left;
-        assignNode->right = right;
-        return assignNode;
+    if (!match(TokenType::STRING)) {
+        fail("Expected string for text analysis");
     }
+    node->left = newNode(currentToken());
+    eat(TokenType::STRING);
 
-    return left;
+    eat(TokenType::RPAREN);
+    return node;
 }
 
+// Pops the operator on top of the stack and its operands into one node
+void Parser::reduce() {
+    const Token& op = tokens[operators.back()];
+    operators.pop_back();
+    ASTNode* right = operands.back();
+    operands.pop_back();
+
+    ASTNode* node = newNode(op);
+    node->left = operands.back();
+    node->right = right;
+    if (op.type == TokenType::ASSIGN) node->slot = assignmentSlot(node->left);
+    operands.back() = node;
+}
+
+// Operator precedence parsing with explicit stacks instead of one call per
+// grammar level and parenthesis, so nesting depth costs no native stack.
+// The operator stack holds token indices; an open ( is its own index.
+// Builds the same trees the grammar
+//   assignment := comparison ('=' assignment)?
+//   comparison := additive (('<' | '>' | '==' | '!=') additive)?
+//   additive   := multiplicative (('+' | '-' | যোগ | বিয়োগ) multiplicative)*
+//   multiplicative := primary (('*' | '/' | গুণ | ভাগ) primary)*
+// describes, and fails at the same token with the same message.
 ASTNode* Parser::parseExpression() {
-    return parseAssignment();
+    // Expressions contain no statements, so this never nests
+    operands.clear();
+    operators.clear();
+    size_t open = 0;  // ( not closed yet
+
+    for (;;) {
+        while (match(TokenType::LPAREN)) {
+            operators.push_back(pos++);
+            open++;
+        }
+        operands.push_back(parseOperand());
+
+        for (;;) {
+            TokenType type = currentToken().type;
+            int precedence = PRECEDENCE[static_cast<size_t>(type)];
+
+            if (precedence) {
+                bool chained = false;
+                while (!operators.empty()) {
+                    TokenType top = tokens[operators.back()].type;
+                    int topPrecedence = PRECEDENCE[static_cast<size_t>(top)];
+                    if (topPrecedence < precedence ||
+                        (topPrecedence == ASSIGNMENT && precedence == ASSIGNMENT)) {
+                        break;  // ( has precedence 0
+                    }
+                    if (topPrecedence == COMPARISON) chained = true;
+                    reduce();
+                }
+                // a < b < c ends after a < b, wherever that leaves the parser
+                if (!(chained && precedence == COMPARISON)) {
+                    operators.push_back(pos++);
+                    break;
+                }
+            } else if (type == TokenType::RPAREN && open > 0) {
+                while (tokens[operators.back()].type != TokenType::LPAREN) reduce();
+                operators.pop_back();
+                open--;
+                pos++;
+                continue;
+            }
+
+            // End of the expression
+            if (open > 0) fail("Syntax error: Unexpected token");  // missing )
+            while (!operators.empty()) reduce();
+            return operands.back();
+        }
+    }
 }
 
 ASTNode* Parser::parsePrintStatement() {
@@ -125,7 +180,7 @@ ASTNode* Parser::parsePrintStatement() {
     ASTNode* expr = parseExpression();
     eat(TokenType::SEMICOLON);
     
-    ASTNode* node = new ASTNode(Token(TokenType::LEKHO));
+    ASTNode* node = newNode(Token(TokenType::LEKHO));
     node->left = expr;
     return node;
 }
@@ -135,16 +190,16 @@ ASTNode* Parser::parseVowelDetect() {
     eat(TokenType::LPAREN);
     
     if (!match(TokenType::STRING)) {
-        throw std::runtime_error("Expected string for vowel detection");
+        fail("Expected string for vowel detection");
     }
     
-    ASTNode* strNode = new ASTNode(currentToken());
+    ASTNode* strNode = newNode(currentToken());
     eat(TokenType::STRING);
     
     eat(TokenType::RPAREN);
     eat(TokenType::SEMICOLON);
     
-    ASTNode* node = new ASTNode(Token(TokenType::SHOROBORNO));
+    ASTNode* node = newNode(Token(TokenType::SHOROBORNO));
     node->left = strNode;
     return node;
 }
@@ -164,7 +219,7 @@ ASTNode* Parser::parseIfStatement() {
         elseBlock = parseStatement();
     }
     
-    ASTNode* node = new ASTNode(Token(TokenType::JODI));
+    ASTNode* node = newNode(Token(TokenType::JODI));
     node->left = condition;
     node->right = thenBlock;
     node->extra = elseBlock;
@@ -172,6 +227,7 @@ ASTNode* Parser::parseIfStatement() {
 }
 
 ASTNode* Parser::parseWhileStatement() {
+    uint32_t offset = currentToken().offset;
     eat(TokenType::JOTOKKHON);
     eat(TokenType::LPAREN);
     
@@ -180,13 +236,15 @@ ASTNode* Parser::parseWhileStatement() {
     
     ASTNode* body = parseStatement();
     
-    ASTNode* node = new ASTNode(Token(TokenType::JOTOKKHON));
+    ASTNode* node = newNode(Token(TokenType::JOTOKKHON));
+    node->offset = static_cast<int>(offset);
     node->left = condition;
     node->right = body;
     return node;
 }
 
 ASTNode* Parser::parseForStatement() {
+    uint32_t offset = currentToken().offset;
     eat(TokenType::PROTIBAR);
     eat(TokenType::LPAREN);
 
@@ -203,15 +261,41 @@ ASTNode* Parser::parseForStatement() {
     ASTNode* body = parseStatement();
 
     // Create for node with body as child
-    ASTNode* node = new ASTNode(Token(TokenType::PROTIBAR));
+    ASTNode* node = newNode(Token(TokenType::PROTIBAR));
+    node->offset = static_cast<int>(offset);
     node->left = init;
     node->right = condition;
     node->extra = increment;
-    node->children.push_back(body);
+    node->children.items = program->arena.make<ASTNode*>(body);
+    node->children.count = 1;
     return node;
 }
 
 ASTNode* Parser::parseStatement() {
+    if (depth == MAX_NESTING) fail("Statements nested too deeply");
+    int outerDeepest = deepest;
+    deepest = ++depth;
+
+    // A remembered statement is only taken where parsing it would not go
+    // past the limit
+    size_t start = pos, end = 0;
+    int height = 0;
+    ASTNode* statement = cache ? cache->find(start, end, height) : nullptr;
+    if (statement && depth - 1 + height <= MAX_NESTING) {
+        pos = end;
+        deepest = depth - 1 + height;
+    } else {
+        statement = parseStatementKind();
+        if (cache) cache->record(start, pos, statement, deepest - depth + 1);
+    }
+    if (statementOffsets) (*statementOffsets)[statement] = tokens[start].offset;
+
+    depth--;
+    deepest = std::max(deepest, outerDeepest);
+    return statement;
+}
+
+ASTNode* Parser::parseStatementKind() {
     if (match(TokenType::LEKHO)) {
         return parsePrintStatement();
     }
@@ -238,24 +322,105 @@ ASTNode* Parser::parseStatement() {
     }
 }
 
+// Parses one statement onto scratch. While collecting diagnostics, a
+// statement with a syntax error is reported and skipped instead.
+void Parser::addStatement() {
+    if (!diagnostics) {
+        scratch.push_back(parseStatement());
+        return;
+    }
+    size_t mark = scratch.size();
+    int outerDepth = depth, outerDeepest = deepest;
+    try {
+        scratch.push_back(parseStatement());
+    } catch (const SyntaxError& e) {
+        scratch.resize(mark);
+        depth = outerDepth;
+        deepest = outerDeepest;
+        diagnostics->push_back(e.diagnostic);
+        synchronize();
+    }
+}
+
+// Skips the rest of a broken statement: through its ;, or through the }
+// of a block it opened. Stops before a } that closes the enclosing block.
+void Parser::synchronize() {
+    int depth = 0;
+    while (!match(TokenType::END)) {
+        TokenType type = currentToken().type;
+        if (type == TokenType::RBRACE) {
+            if (depth == 0) return;
+            pos++;
+            if (--depth == 0) return;
+            continue;
+        }
+        pos++;
+        if (type == TokenType::LBRACE) depth++;
+        else if (type == TokenType::SEMICOLON && depth == 0) return;
+    }
+}
+
 ASTNode* Parser::parseBlock() {
     eat(TokenType::LBRACE);
-    ASTNode* block = new ASTNode(Token(TokenType::LBRACE));
+    ASTNode* block = newNode(Token(TokenType::LBRACE));
     
+    size_t mark = scratch.size();
     while (!match(TokenType::RBRACE) && !match(TokenType::END)) {
-        block->children.push_back(parseStatement());
+        addStatement();
     }
+    block->children = finishList(mark);
     
     eat(TokenType::RBRACE);
     return block;
 }
 
-ASTNode* Parser::parseProgram() {
-    ASTNode* program = new ASTNode(Token(TokenType::LBRACE));
+Program Parser::parseProgram() {
+    // Most programs need fewer nodes than tokens, so one block usually fits
+    Program result(64 + tokens.size() * sizeof(ASTNode));
+    program = &result;
+    pos = 0;
+    depth = deepest = 0;
+    scratch.clear();
+
+    ASTNode* root = newNode(Token(TokenType::LBRACE));
     
     while (!match(TokenType::END)) {
-        program->children.push_back(parseStatement());
+        size_t start = pos;
+        addStatement();
+        if (pos == start) pos++;  // a stray } (already reported) cannot start one
     }
+    root->children = finishList(0);
     
-    return program;
-}
\ No newline at end of file
+    result.root = root;
+    result.slotNames = lexer.symbols().allNames();
+    program = nullptr;
+    return result;
+}
+
+void Parser::checkFrom(size_t at, Program& target) {
+    program = &target;
+    pos = at;
+    depth = deepest = 0;
+    scratch.clear();
+
+    while (!match(TokenType::END)) {
+        size_t start = pos;
+        addStatement();
+        if (pos == start) pos++;
+    }
+    scratch.clear();
+    program = nullptr;
+}
+
+ASTNode* Parser::parseStatementAt(size_t& at, Program& target) {
+    program = &target;
+    pos = at;
+    depth = deepest = 0;
+    scratch.clear();
+
+    ASTNode* statement = parseStatement();
+
+    at = pos;
+    program = nullptr;
+    return statement;
+}
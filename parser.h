@@ -1,51 +1,148 @@
 #pragma once
 #include "lexer.h"
+#include "arena.h"
 #include <vector>
+#include <string>
 #include <stdexcept>
+#include <unordered_map>
 
+struct ASTNode;
+
+// Fixed list of child nodes stored in the program's arena
+struct NodeList {
+    ASTNode** items = nullptr;
+    uint32_t count = 0;
+
+    ASTNode** begin() const { return items; }
+    ASTNode** end() const { return items + count; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    ASTNode* operator[](size_t i) const { return items[i]; }
+};
+
+// AST nodes live in the Program's arena and are never deleted one by one.
+// Only what the evaluator needs from the token is kept: its type, numeric
+// value and (for identifiers and strings) the text. IDENTIFIER and ASSIGN
+// nodes carry the variable slot the parser resolved for them instead, and
+// loops the source offset of their keyword.
 struct ASTNode {
-    Token token;
+    TokenType type;
+    union {
+        int value;
+        int slot;
+        int offset;
+    };
+    StringRef text;
     ASTNode* left;
     ASTNode* right;
     ASTNode* extra;  // For else, increment, etc.
-    std::vector<ASTNode*> children;  // For block statements
-    
-    ASTNode(Token t) : token(t), left(nullptr), right(nullptr), extra(nullptr) {}
-    ~ASTNode() {
-        delete left;
-        delete right;
-        delete extra;
-        for (auto child : children) delete child;
-    }
+    NodeList children;  // For block statements
+
+    ASTNode(TokenType t, int v, StringRef s)
+        : type(t), value(v), text(s), left(nullptr), right(nullptr), extra(nullptr) {}
+};
+
+// Result of parsing: the tree and the arena that owns it. Destroying the
+// program releases every node in one go.
+class Program {
+public:
+    Arena arena;
+    ASTNode* root = nullptr;
+    std::vector<std::string> slotNames;  // variable name of each slot
+
+    explicit Program(size_t arenaSize = 4096) : arena(arenaSize) {}
+    Program(Program&&) = default;
 };
 
+// Source offset of the first token of each statement, for tools that map
+// code back to lines (see Parser::setStatementOffsets)
+typedef std::unordered_map<const ASTNode*, uint32_t> StatementOffsets;
+
+// Statements may nest this deep: blocks, and the bodies of যদি, যতক্ষণ and
+// প্রতিবার. Deeper ones are a syntax error, so every tree walk that follows
+// statements into their bodies has a bounded depth. Expressions have no
+// limit; everything that walks them does so without recursing.
+const int MAX_NESTING = 256;
+
+// Statements parsed earlier, for reparsing an edited program (see
+// incremental.h). A statement's subtree depends only on its own tokens and
+// the one after them (যদি checks for নাহলে), so while those are unchanged
+// the parser can take the old subtree instead of parsing it again.
+class StatementCache {
+public:
+    virtual ~StatementCache() {}
+    // Subtree of the statement starting at tokens[at], the index one past
+    // its last token and how many statement levels it has (1 without a
+    // body), or nullptr
+    virtual ASTNode* find(size_t at, size_t& end, int& height) = 0;
+    virtual void record(size_t at, size_t end, ASTNode* statement, int height) = 0;
+};
+
+// Reads the lexer's tokens in place; both must outlive the parser.
 class Parser {
-    std::vector<Token> tokens;
+    const std::vector<Token>& tokens;
+    Lexer& lexer;
     size_t pos = 0;
+    Program* program = nullptr;
+    StatementCache* cache = nullptr;
+    std::vector<Diagnostic>* diagnostics = nullptr;
+    StatementOffsets* statementOffsets = nullptr;
+    std::vector<ASTNode*> scratch;  // children of the blocks being parsed
+    std::vector<ASTNode*> operands;   // of the expression being parsed
+    std::vector<size_t> operators;    // token indices, ( included
+    int depth = 0;    // statements open around the current one
+    int deepest = 0;  // most open at once inside the current statement
 
-    Token currentToken() { return tokens[pos]; }
+    const Token& currentToken() const { return tokens[pos]; }
+    [[noreturn]] void fail(const char* message);
     void eat(TokenType type);
     bool match(TokenType type);
-    bool matchAny(std::initializer_list<TokenType> types);
-    
+    ASTNode* newNode(const Token& token);
+    int assignmentSlot(ASTNode* target);
+    NodeList finishList(size_t mark);
+
     // Parsing methods
-    ASTNode* parsePrimary();
-    ASTNode* parseMultiplicative();
-    ASTNode* parseAdditive();
-    ASTNode* parseComparison();
-    ASTNode* parseAssignment();
+    ASTNode* parseOperand();
+    ASTNode* parseTextQuery();
+    void reduce();
     ASTNode* parseExpression();
-    
+
     // Statement parsing
     ASTNode* parseStatement();
+    ASTNode* parseStatementKind();
+    void addStatement();
+    void synchronize();
     ASTNode* parseBlock();
     ASTNode* parsePrintStatement();
     ASTNode* parseVowelDetect();
     ASTNode* parseIfStatement();
     ASTNode* parseWhileStatement();
     ASTNode* parseForStatement();
-    
+
 public:
-    Parser(const std::vector<Token>& toks) : tokens(toks) {}
-    ASTNode* parseProgram();
-};
\ No newline at end of file
+    Parser(const std::vector<Token>& toks, Lexer& lex) : tokens(toks), lexer(lex) {}
+
+    // Throws SyntaxError at the first mistake, unless diagnostics are being
+    // collected (see setDiagnostics)
+    Program parseProgram();
+
+    // Collect every syntax error instead of stopping at the first: a broken
+    // statement is reported, skipped to its ; (or past the block it opened,
+    // or up to the } that closes its own block) and parsing goes on. The
+    // program is then incomplete and must not be run if list is non-empty.
+    void setDiagnostics(std::vector<Diagnostic>* list) { diagnostics = list; }
+
+    // Record where every statement parsed from now on starts
+    void setStatementOffsets(StatementOffsets* offsets) { statementOffsets = offsets; }
+
+    // Parses the top-level statements from tokens[at] to the end into
+    // target's arena only to collect their syntax errors, as parseProgram
+    // would from there; needs setDiagnostics
+    void checkFrom(size_t at, Program& target);
+
+    // Parses the top-level statement starting at tokens[at] into target's
+    // arena and moves at past it. With a cache, every statement parsed on
+    // the way is looked up first and recorded after.
+    ASTNode* parseStatementAt(size_t& at, Program& target);
+    void setCache(StatementCache* statements) { cache = statements; }
+};
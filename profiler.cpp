@@ -0,0 +1,138 @@
+#include "profiler.h"
+#include "json.h"
+#include <algorithm>
+#include <cstdio>
+
+static const char* const NODE_NAMES[Profiler::NODE_KINDS] = {
+    "NUM", "PLUS", "MINUS", "MUL", "DIV",
+    "LPAREN", "RPAREN", "LBRACE", "RBRACE",
+    "SEMICOLON", "END", "INVALID",
+    "BANGLA_NUM",
+    "JOG", "BIYOG", "GUN", "BHAG",
+    "JODI", "NAHOLE", "JOTOKKHON", "PROTIBAR",
+    "LEKHO", "SHOROBORNO", "BORNO",
+    "EQ", "NEQ", "LT", "GT",
+    "ASSIGN",
+    "STRING", "IDENTIFIER"
+};
+
+void Profiler::start(const Program& program) {
+    for (NodeStats& stats : nodes) stats = NodeStats();
+    loops.clear();
+    variables.assign(program.slotNames.size(), VariableStats());
+    childNs = 0;
+}
+
+// 1-based line and column (in code points) of a byte offset
+static void position(const std::string& source, uint32_t offset, int& line, int& column) {
+    line = 1;
+    column = 1;
+    for (size_t i = 0; i < offset && i < source.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(source[i]);
+        if (c == '\n') {
+            line++;
+            column = 1;
+        } else if ((c & 0xC0) != 0x80) {
+            column++;
+        }
+    }
+}
+
+static std::vector<const Profiler::LoopStats*> loopsInSourceOrder(
+        const std::unordered_map<const ASTNode*, Profiler::LoopStats>& loops) {
+    std::vector<const Profiler::LoopStats*> sorted;
+    for (const auto& entry : loops) sorted.push_back(&entry.second);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Profiler::LoopStats* a, const Profiler::LoopStats* b) { return a->offset < b->offset; });
+    return sorted;
+}
+
+// Node kinds that ran at least once, most self time first
+static std::vector<size_t> nodeKindsBySelfTime(const Profiler::NodeStats* nodes) {
+    std::vector<size_t> kinds;
+    for (size_t k = 0; k < Profiler::NODE_KINDS; k++) {
+        if (nodes[k].count) kinds.push_back(k);
+    }
+    std::stable_sort(kinds.begin(), kinds.end(),
+                     [nodes](size_t a, size_t b) { return nodes[a].selfNs > nodes[b].selfNs; });
+    return kinds;
+}
+
+std::string Profiler::toJson(const Program& program, const std::string& source) const {
+    std::string json = "{\"nodes\":[";
+    bool first = true;
+    for (size_t k : nodeKindsBySelfTime(nodes)) {
+        if (!first) json += ',';
+        first = false;
+        json += "{\"type\":\"" + std::string(NODE_NAMES[k]) + "\",\"count\":" + std::to_string(nodes[k].count) +
+                ",\"selfNs\":" + std::to_string(nodes[k].selfNs) +
+                ",\"totalNs\":" + std::to_string(nodes[k].totalNs) + "}";
+    }
+
+    json += "],\"loops\":[";
+    first = true;
+    for (const LoopStats* stats : loopsInSourceOrder(loops)) {
+        int line, column;
+        position(source, stats->offset, line, column);
+        if (!first) json += ',';
+        first = false;
+        json += "{\"type\":\"" + std::string(NODE_NAMES[static_cast<size_t>(stats->type)]) +
+                "\",\"offset\":" + std::to_string(stats->offset) +
+                ",\"line\":" + std::to_string(line) + ",\"column\":" + std::to_string(column) +
+                ",\"entries\":" + std::to_string(stats->entries) +
+                ",\"iterations\":" + std::to_string(stats->iterations) + "}";
+    }
+
+    json += "],\"variables\":[";
+    first = true;
+    for (size_t slot = 0; slot < variables.size(); slot++) {
+        if (!variables[slot].reads && !variables[slot].writes) continue;
+        if (!first) json += ',';
+        first = false;
+        json += "{\"name\":" + jsonQuote(program.slotNames[slot]) +
+                ",\"reads\":" + std::to_string(variables[slot].reads) +
+                ",\"writes\":" + std::to_string(variables[slot].writes) + "}";
+    }
+    json += "]}";
+    return json;
+}
+
+void Profiler::writeSummary(std::ostream& out, const Program& program, const std::string& source) const {
+    char row[160];
+    out << "\nপ্রোফাইল (profile)\n";
+
+    out << "node kind            count      self ms     total ms\n";
+    for (size_t k : nodeKindsBySelfTime(nodes)) {
+        std::snprintf(row, sizeof(row), "%-14s %11llu %12.3f %12.3f\n", NODE_NAMES[k],
+                      static_cast<unsigned long long>(nodes[k].count),
+                      nodes[k].selfNs / 1e6, nodes[k].totalNs / 1e6);
+        out << row;
+    }
+
+    std::vector<const LoopStats*> sorted = loopsInSourceOrder(loops);
+    if (!sorted.empty()) {
+        out << "loop at      kind          entries   iterations\n";
+        for (const LoopStats* stats : sorted) {
+            int line, column;
+            position(source, stats->offset, line, column);
+            std::snprintf(row, sizeof(row), "%5d:%-5d  %-10s %10llu %12llu\n", line, column,
+                          NODE_NAMES[static_cast<size_t>(stats->type)],
+                          static_cast<unsigned long long>(stats->entries),
+                          static_cast<unsigned long long>(stats->iterations));
+            out << row;
+        }
+    }
+
+    bool header = false;
+    for (size_t slot = 0; slot < variables.size(); slot++) {
+        if (!variables[slot].reads && !variables[slot].writes) continue;
+        if (!header) {
+            out << "variable                 reads       writes\n";
+            header = true;
+        }
+        std::snprintf(row, sizeof(row), "%-16s %12llu %12llu\n", program.slotNames[slot].c_str(),
+                      static_cast<unsigned long long>(variables[slot].reads),
+                      static_cast<unsigned long long>(variables[slot].writes));
+        out << row;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "parser.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Execution profile of one tree-evaluator run (--profile, or "profile": true
+// in a server request). Evaluator only calls into it from its profiling
+// instantiation, so runs without a profiler pay nothing.
+//
+// Node times come in two flavours: total includes the nodes evaluated
+// underneath, self does not. Loops are keyed by the source offset of their
+// যতক্ষণ/প্রতিবার keyword; variables by slot.
+class Profiler {
+public:
+    // IDENTIFIER is the last TokenType
+    static const size_t NODE_KINDS = static_cast<size_t>(TokenType::IDENTIFIER) + 1;
+
+    struct NodeStats {
+        uint64_t count = 0;
+        uint64_t selfNs = 0;
+        uint64_t totalNs = 0;
+    };
+
+    struct LoopStats {
+        TokenType type = TokenType::JOTOKKHON;
+        uint32_t offset = 0;
+        uint64_t entries = 0;     // times the loop statement was reached
+        uint64_t iterations = 0;  // times the body ran
+    };
+
+    struct VariableStats {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+    };
+
+    // Start of one node evaluation, for enter() and leave()
+    struct Mark {
+        uint64_t start;
+        uint64_t outerChildNs;
+    };
+
+    // Times one node evaluation. Time spent in evaluations that start and
+    // end in between is charged to them, not to this node's self time.
+    Mark enter() {
+        Mark mark = {now(), childNs};
+        childNs = 0;
+        return mark;
+    }
+    void leave(TokenType type, const Mark& mark) {
+        uint64_t elapsed = now() - mark.start;
+        NodeStats& stats = nodes[static_cast<size_t>(type)];
+        stats.count++;
+        stats.totalNs += elapsed;
+        stats.selfNs += elapsed - childNs;
+        childNs = mark.outerChildNs + elapsed;
+    }
+
+    // enter() and leave() around one scope, exceptions included
+    class Scope {
+        Profiler& profiler;
+        TokenType type;
+        Mark mark;
+
+    public:
+        Scope(Profiler& p, TokenType t) : profiler(p), type(t), mark(p.enter()) {}
+        ~Scope() { profiler.leave(type, mark); }
+    };
+
+    NodeStats nodes[NODE_KINDS];
+    std::unordered_map<const ASTNode*, LoopStats> loops;
+    std::vector<VariableStats> variables;
+
+    // Clears all counters; called when a run starts
+    void start(const Program& program);
+
+    LoopStats& loop(const ASTNode* node) {
+        LoopStats& stats = loops[node];
+        stats.type = node->type;
+        stats.offset = static_cast<uint32_t>(node->offset);
+        return stats;
+    }
+
+    // Reports. source is the program text, used to turn loop offsets into
+    // line:column positions.
+    std::string toJson(const Program& program, const std::string& source) const;
+    void writeSummary(std::ostream& out, const Program& program, const std::string& source) const;
+
+private:
+    uint64_t childNs = 0;
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
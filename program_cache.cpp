@@ -0,0 +1,75 @@
+#include "program_cache.h"
+#include <cstring>
+#include <iterator>
+
+// MurmurHash64A: eight bytes per multiply, well mixed in every bit
+uint64_t ProgramCache::hash(const std::string& source) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const size_t length = source.size();
+    const char* data = source.data();
+    uint64_t h = 0x8445d61a4e774912ULL ^ (length * m);
+
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        uint64_t k;
+        std::memcpy(&k, data + i, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    size_t tail = length & 7;
+    if (tail) {
+        uint64_t k = 0;
+        std::memcpy(&k, data + length - tail, tail);
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+void ProgramCache::evict(std::list<Entry>::iterator entry) {
+    totalBytes -= entry->bytes;
+    index.erase(entry->key);
+    entries.erase(entry);
+}
+
+std::shared_ptr<const Program> ProgramCache::find(const std::string& source, bool optimized) {
+    uint64_t key = hash(source) ^ optimized;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) return nullptr;
+    const Entry& entry = *it->second;
+    if (entry.optimized != optimized || entry.source != source) return nullptr;
+
+    entries.splice(entries.begin(), entries, it->second);
+    return entry.program;
+}
+
+void ProgramCache::insert(const std::string& source, bool optimized, std::shared_ptr<const Program> program) {
+    size_t bytes = sizeof(Entry) + source.size() + program->arena.bytesReserved();
+    for (const std::string& name : program->slotNames) bytes += sizeof(name) + name.size();
+    if (bytes > maxBytes || maxEntries == 0) return;
+
+    uint64_t key = hash(source) ^ optimized;
+    std::lock_guard<std::mutex> lock(mutex);
+    // Another thread may have parsed the same source, or one with the
+    // same hash; the newer program replaces it
+    auto it = index.find(key);
+    if (it != index.end()) evict(it->second);
+
+    Entry entry = {key, source, optimized, std::move(program), bytes};
+    entries.push_front(std::move(entry));
+    index[key] = entries.begin();
+    totalBytes += bytes;
+
+    while (entries.size() > maxEntries || totalBytes > maxBytes) {
+        evict(std::prev(entries.end()));
+    }
+}
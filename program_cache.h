@@ -0,0 +1,58 @@
+#pragma once
+#include "parser.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Parsed programs kept across submissions, so a source seen before skips
+// lexing, parsing and optimizing and goes straight to execution. Keyed by
+// a 64-bit hash of the source (and whether it was optimized); a hit also
+// compares the whole source, so a hash collision is only a miss.
+//
+// A Program is never changed by running it and every run starts from fresh
+// variables, so one cached tree serves any number of runs, also at the
+// same time on different threads. Entries are shared_ptrs: one evicted
+// while it runs lives until that run ends.
+//
+// Bounded by entry count and by bytes (source, arena and slot names); the
+// least recently used entries go first. Programs with syntax errors are
+// not cached. Safe to use from several threads.
+class ProgramCache {
+    struct Entry {
+        uint64_t key;
+        std::string source;
+        bool optimized;
+        std::shared_ptr<const Program> program;
+        size_t bytes;
+    };
+
+    std::mutex mutex;
+    std::list<Entry> entries;  // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    size_t maxEntries;
+    size_t maxBytes;
+    size_t totalBytes = 0;
+
+    void evict(std::list<Entry>::iterator entry);
+
+public:
+    static const size_t DEFAULT_ENTRIES = 1024;
+    static const size_t DEFAULT_BYTES = 64 << 20;
+
+    explicit ProgramCache(size_t entryLimit = DEFAULT_ENTRIES, size_t byteLimit = DEFAULT_BYTES)
+        : maxEntries(entryLimit), maxBytes(byteLimit) {}
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // The program parsed from source earlier, or nullptr
+    std::shared_ptr<const Program> find(const std::string& source, bool optimized);
+
+    // Remembers program as the parse of source. A program bigger than the
+    // whole cache is not kept.
+    void insert(const std::string& source, bool optimized, std::shared_ptr<const Program> program);
+
+    static uint64_t hash(const std::string& source);
+};
@@ -0,0 +1,292 @@
+#include "program_file.h"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char PROGRAM_FILE_MAGIC[8] = {'B', 'N', 'G', 'L', 'B', 'C', '\r', '\n'};
+
+static_assert(sizeof(ProgramFileHeader) == 64, "program file header layout");
+static_assert(sizeof(Instruction) == 8 && offsetof(Instruction, arg) == 4, "instruction layout");
+static_assert(sizeof(LoopSpec) == 24 && offsetof(LoopSpec, compare) == 4 && offsetof(LoopSpec, boundIsSlot) == 5 &&
+              offsetof(LoopSpec, bound) == 8 && offsetof(LoopSpec, exit) == 20, "loop layout");
+static_assert(sizeof(StringEntry) == 8 && sizeof(bool) == 1, "string entry layout");
+
+static void put32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+static void align(std::string& out) {
+    while (out.size() % 8) out += '\0';
+}
+
+// Starts a section at the next aligned offset and notes where it is
+static void beginSection(std::string& out, ProgramFileHeader::Section& section, size_t count) {
+    align(out);
+    section.offset = static_cast<uint32_t>(out.size());
+    section.count = static_cast<uint32_t>(count);
+}
+
+static void putStrings(std::string& out, const std::vector<StringEntry>& entries) {
+    for (const StringEntry& entry : entries) {
+        put32(out, entry.offset);
+        put32(out, entry.size);
+    }
+}
+
+void writeProgramFile(const Chunk& chunk, const std::string& path) {
+    ProgramFileHeader header;
+    std::string out(sizeof(header), '\0');
+
+    beginSection(out, header.code, chunk.code.size());
+    for (const Instruction& ins : chunk.code) {
+        put32(out, static_cast<uint8_t>(ins.op));
+        put32(out, static_cast<uint32_t>(ins.arg));
+    }
+    beginSection(out, header.loops, chunk.loops.size());
+    for (const LoopSpec& loop : chunk.loops) {
+        put32(out, static_cast<uint32_t>(loop.slot));
+        put32(out, static_cast<uint8_t>(loop.compare) | static_cast<uint32_t>(loop.boundIsSlot) << 8);
+        put32(out, static_cast<uint32_t>(loop.bound));
+        put32(out, static_cast<uint32_t>(loop.step));
+        put32(out, static_cast<uint32_t>(loop.test));
+        put32(out, static_cast<uint32_t>(loop.exit));
+    }
+    beginSection(out, header.strings, chunk.strings.size());
+    putStrings(out, chunk.strings);
+    beginSection(out, header.names, chunk.names.size());
+    putStrings(out, chunk.names);
+    beginSection(out, header.text, chunk.text.size());
+    out += chunk.text;
+    align(out);
+    if (out.size() > UINT32_MAX) throw std::runtime_error("Program too large for a program file");
+
+    // The header goes in last, field by field, once the sections are placed
+    std::string head(PROGRAM_FILE_MAGIC, sizeof(PROGRAM_FILE_MAGIC));
+    put32(head, PROGRAM_FILE_VERSION);
+    put32(head, 0);
+    put32(head, static_cast<uint32_t>(chunk.maxStack));
+    put32(head, chunk.temporaries);
+    for (const ProgramFileHeader::Section* section : {&header.code, &header.loops, &header.strings,
+                                                      &header.names, &header.text}) {
+        put32(head, section->offset);
+        put32(head, section->count);
+    }
+    out.replace(0, head.size(), head);
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) throw std::runtime_error("Cannot write " + path);
+}
+
+// Points view into a mapped file, or says what is wrong with it. Every
+// index the VM and the JIT use without checking is checked here.
+static const char* checkProgram(const unsigned char* data, size_t size, ChunkView& view) {
+    const uint32_t one = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &one, 1);
+    if (!firstByte) return "Program files need a little-endian machine";
+
+    ProgramFileHeader header;
+    if (size < sizeof(header)) return "Not a program file";
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, PROGRAM_FILE_MAGIC, sizeof(header.magic)) != 0) return "Not a program file";
+    if (header.version != PROGRAM_FILE_VERSION) return "Program file from another version of the compiler";
+    if (header.flags != 0) return "Corrupt program file";
+
+    const struct {
+        const ProgramFileHeader::Section* section;
+        size_t elementSize;
+    } sections[] = {{&header.code, sizeof(Instruction)}, {&header.loops, sizeof(LoopSpec)},
+                    {&header.strings, sizeof(StringEntry)}, {&header.names, sizeof(StringEntry)},
+                    {&header.text, 1}};
+    for (const auto& s : sections) {
+        uint64_t end = s.section->offset + static_cast<uint64_t>(s.section->count) * s.elementSize;
+        if (s.section->offset % 8 || s.section->offset < sizeof(header) || end > size) {
+            return "Corrupt program file";
+        }
+    }
+
+    view.code = reinterpret_cast<const Instruction*>(data + header.code.offset);
+    view.codeSize = header.code.count;
+    view.loops = reinterpret_cast<const LoopSpec*>(data + header.loops.offset);
+    view.loopCount = header.loops.count;
+    view.text = reinterpret_cast<const char*>(data + header.text.offset);
+    view.strings = reinterpret_cast<const StringEntry*>(data + header.strings.offset);
+    view.stringCount = header.strings.count;
+    view.names = reinterpret_cast<const StringEntry*>(data + header.names.offset);
+    view.nameCount = header.names.count;
+    view.maxStack = header.maxStack;
+    // Every temporary is stored to somewhere in the code
+    if (header.temporaries > view.codeSize) return "Corrupt program file";
+    view.slotCount = view.nameCount + header.temporaries;
+
+    const StringEntry* tables[] = {view.strings, view.names};
+    const uint32_t counts[] = {view.stringCount, view.nameCount};
+    for (int t = 0; t < 2; t++) {
+        for (uint32_t i = 0; i < counts[t]; i++) {
+            if (static_cast<uint64_t>(tables[t][i].offset) + tables[t][i].size > header.text.count) {
+                return "Corrupt program file";
+            }
+        }
+    }
+
+    const uint32_t n = view.codeSize;
+    // The VM sizes its stack by maxStack, so a huge one would only waste memory
+    if (n == 0 || view.maxStack < 0 || static_cast<uint32_t>(view.maxStack) > n) return "Corrupt program file";
+    for (uint32_t i = 0; i < view.loopCount; i++) {
+        const unsigned char* raw = data + header.loops.offset + i * sizeof(LoopSpec);
+        const LoopSpec& loop = view.loops[i];
+        OpCode compare = static_cast<OpCode>(raw[offsetof(LoopSpec, compare)]);
+        bool okCompare = compare == OpCode::EQ || compare == OpCode::NEQ || compare == OpCode::LT || compare == OpCode::GT;
+        unsigned char boundIsSlot = raw[offsetof(LoopSpec, boundIsSlot)];
+        if (!okCompare || boundIsSlot > 1 || loop.slot < 0 || static_cast<uint32_t>(loop.slot) >= view.slotCount ||
+            (boundIsSlot && (loop.bound < 0 || static_cast<uint32_t>(loop.bound) >= view.slotCount)) ||
+            loop.test < 0 || static_cast<uint32_t>(loop.test) >= n ||
+            loop.exit < 0 || static_cast<uint32_t>(loop.exit) >= n) {
+            return "Corrupt program file";
+        }
+    }
+
+    // The compiler only jumps with an empty operand stack, so the depth
+    // before each instruction follows from the ones before it
+    std::vector<int> depthAt(n);
+    std::vector<uint32_t> targets;
+    int depth = 0;
+    for (uint32_t pc = 0; pc < n; pc++) {
+        const unsigned char op = data[header.code.offset + pc * sizeof(Instruction)];
+        if (op > static_cast<unsigned char>(OpCode::HALT)) return "Corrupt program file";
+        const Instruction& ins = view.code[pc];
+        depthAt[pc] = depth;
+
+        int inputs = 0;
+        uint32_t limit = UINT32_MAX;  // when arg indexes something, its length
+        switch (ins.op) {
+            case OpCode::LOAD: limit = view.slotCount; break;
+            case OpCode::STORE: inputs = 1; limit = view.slotCount; break;
+            case OpCode::CHECK_DIVISOR: inputs = 1; break;
+            case OpCode::ADD: case OpCode::SUB:
+            case OpCode::MUL: case OpCode::DIV:
+            case OpCode::EQ: case OpCode::NEQ:
+            case OpCode::LT: case OpCode::GT:
+                inputs = 2;
+                break;
+            // Only LOOP and FOR_NEXT count against the step limit, so
+            // every other jump must go forward
+            case OpCode::JUMP: case OpCode::JUMP_IF_FALSE:
+                if (ins.arg <= static_cast<int32_t>(pc)) return "Corrupt program file";
+                limit = n;
+                targets.push_back(static_cast<uint32_t>(ins.arg));
+                break;
+            case OpCode::LOOP:
+                limit = n;
+                targets.push_back(static_cast<uint32_t>(ins.arg));
+                break;
+            case OpCode::FOR_TEST:
+                if (depth != 0 || ins.arg < 0 || static_cast<uint32_t>(ins.arg) >= view.loopCount ||
+                    view.loops[ins.arg].exit <= static_cast<int32_t>(pc)) {
+                    return "Corrupt program file";
+                }
+                break;
+            case OpCode::FOR_NEXT:
+                if (depth != 0) return "Corrupt program file";
+                limit = view.loopCount;
+                break;
+            case OpCode::PRINT_STR: case OpCode::VOWEL_CHECK: case OpCode::FAIL:
+                limit = view.stringCount;
+                break;
+            default:
+                break;
+        }
+        if (limit != UINT32_MAX && (ins.arg < 0 || static_cast<uint32_t>(ins.arg) >= limit)) {
+            return "Corrupt program file";
+        }
+
+        if (depth < inputs) return "Corrupt program file";
+        depth += stackEffect(ins.op);
+        if (depth < 0 || depth > view.maxStack) return "Corrupt program file";
+        if ((ins.op == OpCode::JUMP || ins.op == OpCode::LOOP || ins.op == OpCode::JUMP_IF_FALSE) && depth != 0) {
+            return "Corrupt program file";
+        }
+    }
+    if (view.code[n - 1].op != OpCode::HALT) return "Corrupt program file";
+
+    for (uint32_t i = 0; i < view.loopCount; i++) {
+        targets.push_back(static_cast<uint32_t>(view.loops[i].test));
+        targets.push_back(static_cast<uint32_t>(view.loops[i].exit));
+    }
+    for (uint32_t target : targets) {
+        if (depthAt[target] != 0) return "Corrupt program file";
+    }
+    return nullptr;
+}
+
+void MappedProgram::close() {
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+    chunk = ChunkView();
+}
+
+void MappedProgram::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open " + path);
+    LARGE_INTEGER fileSize;
+    bool sized = GetFileSizeEx(file, &fileSize) != 0;
+    if (!sized || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(ProgramFileHeader)) ||
+        fileSize.QuadPart > UINT32_MAX) {
+        CloseHandle(file);
+        throw std::runtime_error(path + ": Not a program file");
+    }
+    HANDLE handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    const void* view = handle ? MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (handle) CloseHandle(handle);
+        throw std::runtime_error("Cannot map " + path);
+    }
+    mapping = handle;
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ProgramFileHeader)) ||
+        static_cast<uint64_t>(info.st_size) > UINT32_MAX) {
+        ::close(fd);
+        throw std::runtime_error(path + ": Not a program file");
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(info.st_size);
+#endif
+
+    const char* problem = checkProgram(data, size, chunk);
+    if (problem) {
+        close();
+        throw std::runtime_error(path + ": " + problem);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "bytecode.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Compiled programs on disk. A program file is a Chunk laid out exactly
+// as the VM and the JIT read it, so running one maps the file and points
+// a ChunkView into it: no lexing, parsing, compiling or copying.
+//
+// Layout, all little-endian, every section aligned to 8 bytes:
+//   header   ProgramFileHeader (64 bytes)
+//   code     Instruction[]  8 bytes each: opcode, 3 zero bytes, int32 arg
+//   loops    LoopSpec[]     24 bytes each, as declared in bytecode.h
+//   strings  StringEntry[]  offset and size in text
+//   names    StringEntry[]  one per variable slot; the temporaries
+//                           counted in the header come after these
+//   text     the bytes of every string and name, not terminated
+//
+// The version changes whenever the layout or the instruction set does;
+// files of another version are refused, not converted.
+struct ProgramFileHeader {
+    struct Section {
+        uint32_t offset;  // from the start of the file
+        uint32_t count;   // elements (bytes for text)
+    };
+
+    char magic[8];       // PROGRAM_FILE_MAGIC
+    uint32_t version;    // PROGRAM_FILE_VERSION
+    uint32_t flags;      // none yet, always 0
+    int32_t maxStack;
+    uint32_t temporaries;  // Chunk::temporaries
+    Section code, loops, strings, names, text;
+};
+
+extern const char PROGRAM_FILE_MAGIC[8];
+const uint32_t PROGRAM_FILE_VERSION = 3;
+
+// Writes chunk to path. Throws std::runtime_error when the file cannot be
+// written.
+void writeProgramFile(const Chunk& chunk, const std::string& path);
+
+// A program file mapped read-only into memory. open() checks every
+// offset, count, opcode, operand and jump target, and the stack depth
+// along the code, so a truncated, corrupt or hand-made file is refused
+// rather than run out of bounds.
+class MappedProgram {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+    ChunkView chunk;
+
+    void close();
+
+public:
+    MappedProgram() {}
+    ~MappedProgram() { close(); }
+    MappedProgram(const MappedProgram&) = delete;
+    MappedProgram& operator=(const MappedProgram&) = delete;
+
+    // Throws std::runtime_error when path cannot be mapped or does not
+    // hold a valid program of this version
+    void open(const std::string& path);
+
+    // Valid until the next open() or the destructor
+    const ChunkView& view() const { return chunk; }
+};
@@ -8,7 +8,7 @@ echo ========================================
 echo.
 
 echo কম্পাইল করছি...
-g++ -o bangla_compiler main.cpp lexer.cpp parser.cpp evaluator.cpp -std=c++11 -static-libgcc -static-libstdc++
+g++ -o bangla_compiler main.cpp lexer.cpp symbols.cpp parser.cpp evaluator.cpp closure_engine.cpp compiler.cpp ir_builder.cpp ir_optimizer.cpp ir_lowering.cpp vm.cpp runner.cpp json.cpp server.cpp thread_pool.cpp batch.cpp exec_limits.cpp output.cpp optimizer.cpp counted_loop.cpp jit.cpp transpiler.cpp bangla_text.cpp profiler.cpp incremental.cpp debugger.cpp program_cache.cpp program_file.cpp -std=c++11 -static-libgcc -static-libstdc++
 
 if %errorlevel% equ 0 (
     echo কম্পাইল সফল!
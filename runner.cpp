@@ -0,0 +1,138 @@
+#include "runner.h"
+#include "lexer.h"
+#include "evaluator.h"
+#include "closure_engine.h"
+#include "compiler.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "vm.h"
+#include "jit.h"
+#include <stdexcept>
+
+Program parseSource(const std::string& source, bool optimize, std::vector<Diagnostic>* diagnostics) {
+    Lexer lexer(source);
+    std::vector<Token> tokens;
+    try {
+        tokens = lexer.tokenize();
+    } catch (const SyntaxError& e) {
+        // The lexer cannot go on past a bad token
+        if (!diagnostics) throw;
+        diagnostics->push_back(e.diagnostic);
+        return Program();
+    }
+
+    size_t reported = diagnostics ? diagnostics->size() : 0;
+    Parser parser(tokens, lexer);
+    parser.setDiagnostics(diagnostics);
+    Program program = parser.parseProgram();
+    if (optimize && (!diagnostics || diagnostics->size() == reported)) {
+        Optimizer optimizer;
+        optimizer.optimize(program);
+    }
+    return program;
+}
+
+static bool hasLoop(const ASTNode* root) {
+    std::vector<const ASTNode*> unvisited(1, root);
+    while (!unvisited.empty()) {
+        const ASTNode* node = unvisited.back();
+        unvisited.pop_back();
+        if (!node) continue;
+        if (node->type == TokenType::JOTOKKHON || node->type == TokenType::PROTIBAR) return true;
+        unvisited.push_back(node->left);
+        unvisited.push_back(node->right);
+        unvisited.push_back(node->extra);
+        for (const ASTNode* child : node->children) unvisited.push_back(child);
+    }
+    return false;
+}
+
+Chunk compileProgram(const Program& program, bool optimize) {
+    if (!optimize || !hasLoop(program.root)) {
+        Compiler compiler;
+        return compiler.compile(program);
+    }
+    IrBuilder builder;
+    IrProgram ir = builder.build(program);
+    IrOptimizer optimizer;
+    optimizer.optimize(ir);
+    IrLowering lowering;
+    return lowering.lower(ir);
+}
+
+void executeProgram(const Program& program, const RunOptions& options, OutputSink& out,
+                    Profiler* profiler) {
+    if (options.useClosures && !profiler) {
+        ClosureEngine engine;
+        engine.setOutput(out);
+        engine.setLimits(options.limits);
+        if (engine.run(program)) return;
+    }
+    if (options.useTreeEvaluator || options.useClosures || profiler) {
+        Evaluator eval;
+        eval.setOutput(out);
+        eval.setLimits(options.limits);
+        eval.setProfiler(profiler);
+        eval.executeProgram(program);
+    } else {
+        Chunk chunk = compileProgram(program, options.optimize);
+        executeChunk(chunk.view(), options, out);
+    }
+}
+
+void executeChunk(const ChunkView& chunk, const RunOptions& options, OutputSink& out) {
+    if (options.useJit) {
+        Jit jit;
+        jit.setOutput(out);
+        jit.setLimits(options.limits);
+        if (jit.run(chunk)) return;
+    }
+    VM vm;
+    vm.setOutput(out);
+    vm.setLimits(options.limits);
+    vm.run(chunk);
+}
+
+RunResult runProgram(const Program& program, const std::string& source, const RunOptions& options) {
+    RunResult result;
+    BufferSink out;
+    Profiler profiler;
+
+    try {
+        executeProgram(program, options, out, options.profile ? &profiler : nullptr);
+    } catch (const LimitExceeded& e) {
+        result.ok = false;
+        result.error = e.what();
+        result.errorType = e.kindName();
+    } catch (const std::exception& e) {
+        result.ok = false;
+        result.error = e.what();
+        result.errorType = "runtime";
+    }
+    if (options.profile) result.profile = profiler.toJson(program, source);
+
+    result.output = out.take();
+    return result;
+}
+
+RunResult runSource(const std::string& source, const RunOptions& options) {
+    std::shared_ptr<const Program> program;
+    if (options.cache) program = options.cache->find(source, options.optimize);
+    if (program) return runProgram(*program, source, options);
+
+    RunResult result;
+    result.ok = false;
+    result.errorType = "syntax";
+    try {
+        std::shared_ptr<Program> parsed =
+            std::make_shared<Program>(parseSource(source, options.optimize, &result.diagnostics));
+        if (result.diagnostics.empty()) {
+            if (options.cache) options.cache->insert(source, options.optimize, parsed);
+            return runProgram(*parsed, source, options);
+        }
+        result.error = result.diagnostics[0].message;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "parser.h"
+#include "bytecode.h"
+#include "exec_limits.h"
+#include "output.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include <string>
+#include <vector>
+
+// How a program is executed
+struct RunOptions {
+    bool useTreeEvaluator = false;  // tree-walking Evaluator instead of the VM
+    bool useJit = false;            // native code where available, else the VM
+    bool useClosures = false;       // closure-compiled tree (see closure_engine.h)
+    bool optimize = true;           // run Optimizer over the AST first
+    bool profile = false;           // tree evaluator with a Profiler (see profiler.h)
+    ExecutionLimits limits;
+    ProgramCache* cache = nullptr;  // parsed programs runSource may reuse
+};
+
+// Outcome of running one submission with its output captured
+struct RunResult {
+    bool ok = true;
+    std::string output;
+    std::string error;      // set when ok is false
+    std::string errorType;  // "syntax", "runtime", or a LimitExceeded kind name
+    std::string profile;    // JSON report when options.profile, also after a runtime error
+    std::string debug;      // JSON state of a debug session after the request (see server.h)
+    std::vector<Diagnostic> diagnostics;  // every syntax error, when errorType is "syntax"
+};
+
+// Lexes and parses source into a program, optimizing it unless asked not
+// to. Throws SyntaxError at the first mistake; with a diagnostics list,
+// appends every syntax error to it instead and returns an incomplete,
+// unoptimized program if there were any.
+Program parseSource(const std::string& source, bool optimize = true,
+                    std::vector<Diagnostic>* diagnostics = nullptr);
+
+// Runs a parsed program with fresh variables, printing to out. The sink is
+// flushed once when the program finishes or fails. With a profiler the
+// program always runs on the tree evaluator.
+void executeProgram(const Program& program, const RunOptions& options, OutputSink& out,
+                    Profiler* profiler = nullptr);
+
+// Compiles a parsed program to bytecode. With optimize, a program with
+// loops goes through the SSA IR (see ir.h) and its optimizations; one
+// without runs each statement once, so it is compiled directly.
+Chunk compileProgram(const Program& program, bool optimize);
+
+// Runs compiled code (from compileProgram, or a mapped program file) on the JIT
+// when options.useJit and it is available, else on the VM
+void executeChunk(const ChunkView& chunk, const RunOptions& options, OutputSink& out);
+
+// Runs an already parsed program with its output captured; source is only
+// used to place loops in a profile
+RunResult runProgram(const Program& program, const std::string& source, const RunOptions& options);
+
+// Parses and runs source, capturing everything it prints. With a cache,
+// a source parsed before is not parsed again, and a new one is added.
+RunResult runSource(const std::string& source, const RunOptions& options);
@@ -0,0 +1,199 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Byte-class scanning used by the lexer. Token boundaries are always ASCII
+// (whitespace and the operator/punctuation characters below), and UTF-8
+// never uses ASCII bytes inside a multi-byte sequence, so finding the end
+// of a word is a search for the first delimiter byte. The vector paths
+// classify 16 (SSE2) or 32 (AVX2) bytes per step; the scalar path handles
+// tails and other targets.
+
+inline bool isSpaceByte(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Whitespace or one of ( ) { } ; " + - * / = ! < >
+inline bool isDelimiterByte(unsigned char c) {
+    switch (c) {
+        case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+        case '(': case ')': case '{': case '}': case ';': case '"':
+        case '+': case '-': case '*': case '/': case '=': case '!':
+        case '<': case '>':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Length of the UTF-8 sequence starting at p (at most avail bytes), or 0
+// if p does not start a well-formed sequence.
+inline size_t utf8SequenceLength(const unsigned char* p, size_t avail) {
+    unsigned char c = p[0];
+    size_t len;
+    if (c < 0x80) return 1;
+    else if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) len = 3;
+    else if (c >= 0xF0 && c <= 0xF4) len = 4;
+    else return 0;  // continuation byte, overlong lead or out of range
+
+    if (len > avail) return 0;
+    for (size_t i = 1; i < len; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    // Reject overlong 3/4-byte forms, surrogates and code points > U+10FFFF
+    if (c == 0xE0 && p[1] < 0xA0) return 0;
+    if (c == 0xED && p[1] > 0x9F) return 0;
+    if (c == 0xF0 && p[1] < 0x90) return 0;
+    if (c == 0xF4 && p[1] > 0x8F) return 0;
+    return len;
+}
+
+// Decodes the code point at p. Malformed input yields U+FFFD and a length
+// of 1, so callers always make progress.
+inline uint32_t utf8Decode(const unsigned char* p, size_t avail, size_t& length) {
+    length = utf8SequenceLength(p, avail);
+    switch (length) {
+        case 1: return p[0];
+        case 2: return ((p[0] & 0x1Fu) << 6) | (p[1] & 0x3Fu);
+        case 3: return ((p[0] & 0x0Fu) << 12) | ((p[1] & 0x3Fu) << 6) | (p[2] & 0x3Fu);
+        case 4: return ((p[0] & 0x07u) << 18) | ((p[1] & 0x3Fu) << 12) |
+                       ((p[2] & 0x3Fu) << 6) | (p[3] & 0x3Fu);
+        default:
+            length = 1;
+            return 0xFFFD;
+    }
+}
+
+#if defined(__AVX2__)
+
+inline uint32_t delimiterMask(__m256i v) {
+    // Unsigned "x in [lo, lo + span]" as min(x - lo, span) == x - lo
+    #define BANGLA_IN_RANGE(lo, span) \
+        _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), \
+                                          _mm256_set1_epi8(span)), \
+                          _mm256_sub_epi8(v, _mm256_set1_epi8(lo)))
+    __m256i m = _mm256_or_si256(BANGLA_IN_RANGE('\t', 4), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    m = _mm256_or_si256(m, BANGLA_IN_RANGE('!', 1));   // ! "
+    m = _mm256_or_si256(m, BANGLA_IN_RANGE('(', 3));   // ( ) * +
+    m = _mm256_or_si256(m, BANGLA_IN_RANGE(';', 3));   // ; < = >
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')));
+    #undef BANGLA_IN_RANGE
+    return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+}
+
+inline uint32_t spaceMask(__m256i v) {
+    __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(4)), t);
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+}
+
+inline uint32_t nonAsciiMask(__m256i v) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+}
+
+#define BANGLA_SCAN_WIDTH 32
+#define BANGLA_SCAN_LOAD(p) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+inline uint32_t delimiterMask(__m128i v) {
+    #define BANGLA_IN_RANGE(lo, span) \
+        _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(span)), \
+                       _mm_sub_epi8(v, _mm_set1_epi8(lo)))
+    __m128i m = _mm_or_si128(BANGLA_IN_RANGE('\t', 4), _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    m = _mm_or_si128(m, BANGLA_IN_RANGE('!', 1));   // ! "
+    m = _mm_or_si128(m, BANGLA_IN_RANGE('(', 3));   // ( ) * +
+    m = _mm_or_si128(m, BANGLA_IN_RANGE(';', 3));   // ; < = >
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('{')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('}')));
+    #undef BANGLA_IN_RANGE
+    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+}
+
+inline uint32_t spaceMask(__m128i v) {
+    __m128i t = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t);
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+}
+
+inline uint32_t nonAsciiMask(__m128i v) {
+    return static_cast<uint32_t>(_mm_movemask_epi8(v));
+}
+
+#define BANGLA_SCAN_WIDTH 16
+#define BANGLA_SCAN_LOAD(p) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+
+#endif
+
+inline unsigned lowestSetBit(uint32_t mask) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+    unsigned i = 0;
+    while (!(mask & 1u)) { mask >>= 1; i++; }
+    return i;
+#endif
+}
+
+// Index of the first delimiter in data[from, length), or length
+inline size_t findDelimiter(const char* data, size_t from, size_t length) {
+    size_t i = from;
+#ifdef BANGLA_SCAN_WIDTH
+    while (i + BANGLA_SCAN_WIDTH <= length) {
+        uint32_t mask = delimiterMask(BANGLA_SCAN_LOAD(data + i));
+        if (mask) return i + lowestSetBit(mask);
+        i += BANGLA_SCAN_WIDTH;
+    }
+#endif
+    while (i < length && !isDelimiterByte(static_cast<unsigned char>(data[i]))) i++;
+    return i;
+}
+
+// Index of the first non-whitespace byte in data[from, length), or length
+inline size_t skipSpaces(const char* data, size_t from, size_t length) {
+    size_t i = from;
+    // Most gaps are a single space: settle those without touching vectors
+    while (i < length && i < from + 2) {
+        if (!isSpaceByte(static_cast<unsigned char>(data[i]))) return i;
+        i++;
+    }
+#ifdef BANGLA_SCAN_WIDTH
+    const uint32_t all = BANGLA_SCAN_WIDTH == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+    while (i + BANGLA_SCAN_WIDTH <= length) {
+        uint32_t mask = spaceMask(BANGLA_SCAN_LOAD(data + i)) ^ all;
+        if (mask) return i + lowestSetBit(mask);
+        i += BANGLA_SCAN_WIDTH;
+    }
+#endif
+    while (i < length && isSpaceByte(static_cast<unsigned char>(data[i]))) i++;
+    return i;
+}
+
+// Index of the first byte >= 0x80 in data[from, length), or length
+inline size_t skipAscii(const char* data, size_t from, size_t length) {
+    size_t i = from;
+#ifdef BANGLA_SCAN_WIDTH
+    while (i + BANGLA_SCAN_WIDTH <= length) {
+        uint32_t mask = nonAsciiMask(BANGLA_SCAN_LOAD(data + i));
+        if (mask) return i + lowestSetBit(mask);
+        i += BANGLA_SCAN_WIDTH;
+    }
+#endif
+    while (i < length && static_cast<unsigned char>(data[i]) < 0x80) i++;
+    return i;
+}
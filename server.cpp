@@ -0,0 +1,415 @@
+#include "server.h"
+#include "json.h"
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static std::string errorResponse(const std::string& id, const std::string& message) {
+    return "{\"id\":" + id + ",\"ok\":false,\"output\":\"\",\"error\":" + jsonQuote(message) +
+           ",\"errorType\":\"request\"}";
+}
+
+// Reads an optional non-negative integer field; false if present but bad
+static bool readLimit(const JsonObject& request, const char* key, uint64_t& value) {
+    auto it = request.find(key);
+    if (it == request.end()) return true;
+    const std::string& text = it->second.value;
+    if (it->second.isString || text.empty() || text.size() > 19 ||
+        text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::stoull(text);
+    return true;
+}
+
+// Session requests (see server.h); options are already read
+static std::string handleSessionRequest(const std::string& id, const JsonObject& request,
+                                        const RunOptions& options, EditSessions* sessions) {
+    if (!sessions) return errorResponse(id, "Invalid request: sessions need --serve or --socket");
+    const JsonField& name = request.at("session");
+    if (!name.isString) return errorResponse(id, "Invalid request: \"session\" must be a string");
+    auto session = sessions->find(name.value);
+
+    auto close = request.find("close");
+    if (close != request.end() && close->second.value == "true") {
+        if (session != sessions->end()) sessions->erase(session);
+        return formatResponse(id, RunResult());
+    }
+
+    auto code = request.find("code");
+    if (code != request.end()) {
+        if (!code->second.isString) return errorResponse(id, "Invalid request: missing \"code\" string");
+        if (session == sessions->end()) {
+            if (sessions->size() >= MAX_EDIT_SESSIONS) {
+                return errorResponse(id, "Invalid request: too many sessions");
+            }
+            session = sessions->emplace(name.value, std::unique_ptr<EditSession>(new EditSession())).first;
+        }
+        session->second->reset(code->second.value);
+    } else {
+        if (session == sessions->end()) return errorResponse(id, "Invalid request: unknown session");
+        uint64_t offset = 0, removed = 0;
+        auto text = request.find("text");
+        if (!readLimit(request, "offset", offset) || !readLimit(request, "removed", removed) ||
+            (text != request.end() && !text->second.isString)) {
+            return errorResponse(id, "Invalid request: bad edit offset, length or text");
+        }
+        try {
+            session->second->edit(static_cast<size_t>(offset), static_cast<size_t>(removed),
+                                  text != request.end() ? text->second.value : std::string());
+        } catch (const std::out_of_range&) {
+            return errorResponse(id, "Invalid request: edit outside the source");
+        }
+    }
+
+    const EditSession& edited = *session->second;
+    if (!edited.ok()) {
+        RunResult result;
+        result.ok = false;
+        result.error = edited.error();
+        result.errorType = "syntax";
+        result.diagnostics = edited.diagnostics();
+        return formatResponse(id, result);
+    }
+    return formatResponse(id, runProgram(edited.program(), edited.source(), options));
+}
+
+// Reads a JSON array of line numbers; false if it is anything else
+static bool readLines(const JsonField& field, std::vector<uint32_t>& lines) {
+    const std::string& text = field.raw;
+    if (field.isString || text.size() < 2 || text[0] != '[' || text[text.size() - 1] != ']') return false;
+    std::string inside = text.substr(1, text.size() - 2);
+    if (inside.find_first_not_of(" \t") == std::string::npos) return true;
+
+    size_t start = 0;
+    for (;;) {
+        size_t comma = inside.find(',', start);
+        std::string item = inside.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        size_t first = item.find_first_not_of(" \t"), last = item.find_last_not_of(" \t");
+        if (first == std::string::npos) return false;
+        item = item.substr(first, last - first + 1);
+        if (item.size() > 9 || item.find_first_not_of("0123456789") != std::string::npos) return false;
+        lines.push_back(static_cast<uint32_t>(std::stoul(item)));
+        if (comma == std::string::npos) return true;
+        start = comma + 1;
+    }
+}
+
+// The "debug" object of a response
+static std::string debugState(const DebugSession& session, StopReason reason) {
+    static const char* const reasons[] = {"step", "breakpoint", "output"};
+    const DebugProgram::Statement* at = session.location();
+    std::string state = session.finished() ? "{\"state\":\"finished\",\"reason\":null"
+                                           : "{\"state\":\"paused\",\"reason\":\"" +
+                                                 std::string(reasons[static_cast<int>(reason)]) + "\"";
+    state += at ? ",\"line\":" + std::to_string(at->line) + ",\"column\":" + std::to_string(at->column)
+                : std::string(",\"line\":null,\"column\":null");
+    state += ",\"variables\":{";
+    bool first = true;
+    for (const auto& variable : session.variables()) {
+        if (!first) state += ',';
+        first = false;
+        state += jsonQuote(variable.first) + ":" + std::to_string(variable.second);
+    }
+    return state + "}}";
+}
+
+// Debug requests (see server.h); options are already read
+static std::string handleDebugRequest(const std::string& id, const JsonObject& request,
+                                      const RunOptions& options, DebugSessions* debugging) {
+    if (!debugging) return errorResponse(id, "Invalid request: debugging needs --serve or --socket");
+    const JsonField& name = request.at("debug");
+    if (!name.isString) return errorResponse(id, "Invalid request: \"debug\" must be a string");
+    auto session = debugging->sessions.find(name.value);
+
+    auto close = request.find("close");
+    if (close != request.end() && close->second.value == "true") {
+        if (session != debugging->sessions.end()) debugging->sessions.erase(session);
+        return formatResponse(id, RunResult());
+    }
+
+    StopConditions stop;
+    std::vector<uint32_t> lines;
+    auto breakpoints = request.find("breakpoints");
+    auto stopAtOutput = request.find("stopAtOutput");
+    if (!readLimit(request, "steps", stop.statements) ||
+        (breakpoints != request.end() && !readLines(breakpoints->second, lines)) ||
+        (stopAtOutput != request.end() && stopAtOutput->second.value != "true" &&
+         stopAtOutput->second.value != "false")) {
+        return errorResponse(id, "Invalid request: bad steps, breakpoints or stopAtOutput");
+    }
+    stop.afterOutput = stopAtOutput != request.end() && stopAtOutput->second.value == "true";
+
+    auto code = request.find("code");
+    if (code != request.end()) {
+        if (!code->second.isString) return errorResponse(id, "Invalid request: missing \"code\" string");
+        if (session == debugging->sessions.end() && debugging->sessions.size() >= MAX_DEBUG_SESSIONS) {
+            return errorResponse(id, "Invalid request: too many sessions");
+        }
+        std::shared_ptr<const DebugProgram> program = debugging->programs[code->second.value].lock();
+        if (!program) {
+            RunResult result;
+            program = compileForDebugging(code->second.value, result.diagnostics);
+            if (!program) {
+                debugging->programs.erase(code->second.value);
+                result.ok = false;
+                result.error = result.diagnostics[0].message;
+                result.errorType = "syntax";
+                return formatResponse(id, result);
+            }
+            // Forget the sources no session runs any more
+            for (auto it = debugging->programs.begin(); it != debugging->programs.end();) {
+                if (it->second.expired()) it = debugging->programs.erase(it);
+                else ++it;
+            }
+            debugging->programs[code->second.value] = program;
+        }
+        DebugSession started(program, options.limits);
+        if (session == debugging->sessions.end()) session = debugging->sessions.emplace(name.value, started).first;
+        else session->second = started;
+    } else if (session == debugging->sessions.end()) {
+        return errorResponse(id, "Invalid request: unknown session");
+    }
+    if (breakpoints != request.end()) session->second.setBreakpoints(lines);
+
+    RunResult result;
+    BufferSink out;
+    StopReason reason = StopReason::FINISHED;
+    try {
+        reason = session->second.resume(out, stop);
+    } catch (const LimitExceeded& e) {
+        result.ok = false;
+        result.error = e.what();
+        result.errorType = e.kindName();
+    } catch (const std::exception& e) {
+        result.ok = false;
+        result.error = e.what();
+        result.errorType = "runtime";
+    }
+    result.output = out.take();
+    result.debug = debugState(session->second, reason);
+    return formatResponse(id, result);
+}
+
+std::string handleRequest(const std::string& line, const RunOptions& defaults, EditSessions* sessions,
+                          DebugSessions* debugging) {
+    JsonObject request;
+    std::string parseError;
+    if (!parseJsonObject(line, request, parseError)) {
+        return errorResponse("null", "Invalid request: " + parseError);
+    }
+
+    std::string id = request.count("id") ? request["id"].raw : "null";
+
+    bool session = request.count("session") != 0;
+    bool debug = request.count("debug") != 0;
+    auto code = request.find("code");
+    if (!session && !debug && (code == request.end() || !code->second.isString)) {
+        return errorResponse(id, "Invalid request: missing \"code\" string");
+    }
+
+    RunOptions options = defaults;
+    auto engine = request.find("engine");
+    if (engine != request.end()) {
+        options.useTreeEvaluator = false;
+        options.useJit = false;
+        options.useClosures = false;
+        if (engine->second.value == "tree") options.useTreeEvaluator = true;
+        else if (engine->second.value == "jit") options.useJit = true;
+        else if (engine->second.value == "closures") options.useClosures = true;
+        else if (engine->second.value != "vm") return errorResponse(id, "Invalid request: unknown engine");
+    }
+
+    auto profile = request.find("profile");
+    if (profile != request.end()) {
+        if (profile->second.value == "true") options.profile = true;
+        else if (profile->second.value == "false") options.profile = false;
+        else return errorResponse(id, "Invalid request: profile must be true or false");
+    }
+
+    uint64_t maxSteps = options.limits.maxSteps;
+    uint64_t timeoutMs = options.limits.timeoutMs;
+    uint64_t maxMemory = options.limits.maxMemoryBytes;
+    if (!readLimit(request, "maxSteps", maxSteps) ||
+        !readLimit(request, "timeoutMs", timeoutMs) || timeoutMs > 0xFFFFFFFFu ||
+        !readLimit(request, "maxMemory", maxMemory)) {
+        return errorResponse(id, "Invalid request: limits must be non-negative integers");
+    }
+    options.limits.maxSteps = maxSteps;
+    options.limits.timeoutMs = static_cast<uint32_t>(timeoutMs);
+    options.limits.maxMemoryBytes = static_cast<size_t>(maxMemory);
+
+    if (session) return handleSessionRequest(id, request, options, sessions);
+    if (debug) return handleDebugRequest(id, request, options, debugging);
+    return formatResponse(id, runSource(code->second.value, options));
+}
+
+std::string formatResponse(const std::string& id, const RunResult& result) {
+    std::string response = "{\"id\":" + id;
+    response += result.ok ? ",\"ok\":true" : ",\"ok\":false";
+    response += ",\"output\":" + jsonQuote(result.output);
+    response += ",\"error\":" + (result.ok ? std::string("null") : jsonQuote(result.error));
+    response += ",\"errorType\":" + (result.ok ? std::string("null") : jsonQuote(result.errorType));
+    if (!result.diagnostics.empty()) {
+        response += ",\"diagnostics\":[";
+        for (size_t i = 0; i < result.diagnostics.size(); i++) {
+            const Diagnostic& d = result.diagnostics[i];
+            if (i) response += ',';
+            response += "{\"message\":" + jsonQuote(d.message) + ",\"offset\":" + std::to_string(d.offset) +
+                        ",\"line\":" + std::to_string(d.line) + ",\"column\":" + std::to_string(d.column) + "}";
+        }
+        response += "]";
+    }
+    if (!result.profile.empty()) response += ",\"profile\":" + result.profile;
+    if (!result.debug.empty()) response += ",\"debug\":" + result.debug;
+    response += "}";
+    return response;
+}
+
+void serveStream(std::istream& in, std::ostream& out, const RunOptions& defaults) {
+    EditSessions sessions;
+    DebugSessions debugging;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+
+        out << handleRequest(line, defaults, &sessions, &debugging) << '\n';
+        out.flush();
+    }
+}
+
+#ifndef _WIN32
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void serveConnection(int fd, RunOptions defaults) {
+    EditSessions sessions;
+    DebugSessions debugging;
+    std::string pending;
+    char buffer[65536];
+
+    for (;;) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        pending.append(buffer, static_cast<size_t>(n));
+
+        size_t start = 0;
+        size_t newline;
+        std::string responses;
+        while ((newline = pending.find('\n', start)) != std::string::npos) {
+            std::string line = pending.substr(start, newline - start);
+            start = newline + 1;
+            if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+            if (line.find_first_not_of(" \t") == std::string::npos) continue;
+            responses += handleRequest(line, defaults, &sessions, &debugging);
+            responses += '\n';
+        }
+        pending.erase(0, start);
+
+        if (!responses.empty() && !writeAll(fd, responses)) break;
+    }
+    ::close(fd);
+}
+
+int serveUnixSocket(const std::string& path, const RunOptions& defaults) {
+    std::signal(SIGPIPE, SIG_IGN);  // a client hanging up must not kill the server
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return 1;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    // A socket left by an earlier server, never another file
+    struct stat existing;
+    if (::lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listener, 64) < 0) {
+        std::perror("bind/listen");
+        ::close(listener);
+        return 1;
+    }
+
+    // Connection threads use defaults (and its cache) until they finish,
+    // so this does not return before they have
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t active = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return active < MAX_CONNECTIONS; });
+        }
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Out of descriptors or memory for now: let connections finish
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            std::perror("accept");
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        try {
+            std::thread([fd, &defaults, &mutex, &finished, &active] {
+                serveConnection(fd, defaults);
+                std::lock_guard<std::mutex> done(mutex);
+                active--;
+                finished.notify_all();
+            }).detach();
+            active++;
+        } catch (const std::system_error&) {
+            ::close(fd);  // no thread to serve it
+        }
+    }
+
+    ::close(listener);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return active == 0; });
+    return 1;
+}
+
+#else
+
+int serveUnixSocket(const std::string&, const RunOptions&) {
+    std::cerr << "Unix socket mode is not available on Windows; use --serve with stdin\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#pragma once
+#include "runner.h"
+#include "incremental.h"
+#include "debugger.h"
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// Long-lived mode: one process serves many submissions. Requests and
+// responses are newline-delimited JSON objects:
+//
+//   -> {"id": 7, "code": "লেখ দুই যোগ তিন;"}
+//   <- {"id":7,"ok":true,"output":"লেখ: 5\n","error":null,"errorType":null}
+//
+// "id" is echoed back verbatim. An optional "engine" of "tree", "vm", "jit"
+// or "closures" and "maxSteps", "timeoutMs" and "maxMemory" (see
+// ExecutionLimits) override the server defaults. So that a program that
+// never ends cannot hold a worker for good, those default to
+// DEFAULT_MAX_STEPS loop iterations, DEFAULT_TIMEOUT_MS and
+// DEFAULT_MAX_MEMORY bytes here and in --batch, unless --max-steps,
+// --timeout-ms or --max-memory say otherwise; 0 lifts a limit.
+// "profile": true runs the tree evaluator and adds a "profile" object to
+// the response (see Profiler::toJson). Each program runs with fresh
+// variables.
+// errorType is "syntax", "runtime", "step_limit", "time_limit",
+// "memory_limit" or "request". A syntax error response also lists every
+// mistake found in one pass:
+//
+//   "diagnostics":[{"message":"...","offset":12,"line":2,"column":5},...]
+//
+// offset is in bytes, line and column count from 1, column in code points.
+//
+// Editors can keep a program parsed on the connection instead of sending
+// all of it every time (see EditSession):
+//
+//   -> {"id": 1, "session": "a", "code": "লেখ ১;"}
+//   -> {"id": 2, "session": "a", "offset": 7, "removed": 3, "text": "২"}
+//   -> {"id": 3, "session": "a", "close": true}
+//
+// "code" starts the session (or replaces its source); an edit replaces
+// "removed" bytes at byte "offset" of the UTF-8 source with "text". Both
+// run the updated program like any other request, except that it is not
+// optimized. A connection holds at most MAX_EDIT_SESSIONS sessions.
+
+static const uint64_t DEFAULT_MAX_STEPS = 100000000;
+static const uint32_t DEFAULT_TIMEOUT_MS = 10000;
+static const size_t DEFAULT_MAX_MEMORY = 16 << 20;
+
+static const size_t MAX_EDIT_SESSIONS = 16;
+typedef std::map<std::string, std::unique_ptr<EditSession>> EditSessions;
+
+// Step debugging keeps programs paused on the connection between requests
+// (see DebugSession):
+//
+//   -> {"id": 1, "debug": "d", "code": "...", "breakpoints": [3, 7], "steps": 1}
+//   -> {"id": 2, "debug": "d", "stopAtOutput": true}
+//   -> {"id": 3, "debug": "d", "close": true}
+//
+// "code" starts the session, or starts it over, before its first
+// statement. Every request but "close" then runs it until it has reached
+// "steps" more statements, printed something (with "stopAtOutput"), hit a
+// breakpoint line or ended. "breakpoints" replaces the session's
+// breakpoint lines. The response has what was printed meanwhile, errors
+// as for any run, and where the session is:
+//
+//   "debug":{"state":"paused","reason":"breakpoint","line":3,"column":1,"variables":{"a":2}}
+//
+// reason is "step", "breakpoint" or "output"; once the program has ended
+// or failed, state is "finished" and reason, line and column are null.
+// Limits come from the request that started the session. Sessions of the
+// same source share its compiled program, and a connection holds at most
+// MAX_DEBUG_SESSIONS.
+
+static const size_t MAX_DEBUG_SESSIONS = 4096;
+struct DebugSessions {
+    std::map<std::string, DebugSession> sessions;
+    std::map<std::string, std::weak_ptr<const DebugProgram>> programs;  // by source
+};
+
+// Handles one request line and returns the response line (no newline).
+// Without sessions (batch mode), session and debug requests are rejected.
+std::string handleRequest(const std::string& line, const RunOptions& defaults,
+                          EditSessions* sessions = nullptr, DebugSessions* debugging = nullptr);
+
+// Builds the response line for a finished run; id is raw JSON
+std::string formatResponse(const std::string& id, const RunResult& result);
+
+// Serves requests from in until EOF, flushing after every response
+void serveStream(std::istream& in, std::ostream& out, const RunOptions& defaults);
+
+// Listens on a Unix domain socket and serves each connection on its own
+// thread, at most MAX_CONNECTIONS at once; more wait in the listen
+// backlog. An existing socket at path is replaced, any other file is left
+// alone. Returns non-zero if the socket cannot be set up or accept fails
+// for good, once every connection has finished; not available on Windows.
+static const size_t MAX_CONNECTIONS = 256;
+int serveUnixSocket(const std::string& path, const RunOptions& defaults);
@@ -0,0 +1,58 @@
+#include "symbols.h"
+#include <cstring>
+
+// FNV-1a: short Bangla names are only a few 3-byte code points
+uint32_t SymbolTable::hash(const char* data, size_t length) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void SymbolTable::grow() {
+    std::vector<int32_t> bigger(buckets.size() * 2, -1);
+    size_t mask = bigger.size() - 1;
+    for (size_t id = 0; id < names.size(); id++) {
+        size_t i = hashes[id] & mask;
+        while (bigger[i] != -1) i = (i + 1) & mask;
+        bigger[i] = static_cast<int32_t>(id);
+    }
+    buckets.swap(bigger);
+}
+
+int SymbolTable::probe(const char* data, size_t length, uint32_t h) const {
+    size_t mask = buckets.size() - 1;
+    for (size_t i = h & mask; buckets[i] != -1; i = (i + 1) & mask) {
+        int id = buckets[i];
+        if (hashes[id] == h && names[id].size() == length &&
+            std::memcmp(names[id].data(), data, length) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+int SymbolTable::find(const char* data, size_t length) const {
+    return probe(data, length, hash(data, length));
+}
+
+int SymbolTable::intern(const char* data, size_t length) {
+    uint32_t h = hash(data, length);
+    int id = probe(data, length, h);
+    if (id != -1) return id;
+
+    // Keep the table at most half full
+    if ((names.size() + 1) * 2 > buckets.size()) grow();
+
+    id = static_cast<int>(names.size());
+    names.push_back(std::string(data, length));
+    hashes.push_back(h);
+
+    size_t mask = buckets.size() - 1;
+    size_t i = h & mask;
+    while (buckets[i] != -1) i = (i + 1) & mask;
+    buckets[i] = id;
+    return id;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Interns identifier spellings to dense integer ids. Lookups take a
+// pointer and length into the source, so seeing a known name again costs
+// one hash and one compare, with no allocation.
+class SymbolTable {
+    std::vector<std::string> names;
+    std::vector<uint32_t> hashes;   // hash of each name, for rehashing
+    std::vector<int32_t> buckets;   // open addressing, -1 = empty
+
+    static uint32_t hash(const char* data, size_t length);
+    void grow();
+    int probe(const char* data, size_t length, uint32_t h) const;
+
+public:
+    SymbolTable() : buckets(64, -1) {}
+
+    int intern(const char* data, size_t length);
+    int intern(const std::string& name) { return intern(name.data(), name.size()); }
+    int find(const char* data, size_t length) const;
+
+    const std::string& name(int id) const { return names[id]; }
+    const std::vector<std::string>& allNames() const { return names; }
+    size_t size() const { return names.size(); }
+};
@@ -0,0 +1,90 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned threads) : queued(0), nextQueue(0) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    for (unsigned i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Spread submissions round-robin; stealing evens out the rest
+    unsigned target = nextQueue++ % queues.size();
+    {
+        // Count the task first so no worker can finish it before it is counted
+        std::lock_guard<std::mutex> lock(stateMutex);
+        pending++;
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    idle.wait(lock, [this] { return pending == 0; });
+}
+
+bool ThreadPool::popLocal(unsigned self, std::function<void()>& task) {
+    Queue& queue = *queues[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned self, std::function<void()>& task) {
+    size_t count = queues.size();
+    for (size_t i = 1; i < count; i++) {
+        Queue& victim = *queues[(self + i) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned self) {
+    std::function<void()> task;
+
+    for (;;) {
+        if (popLocal(self, task) || steal(self, task)) {
+            queued--;
+            try {
+                task();
+            } catch (...) {
+                // Tasks report their own errors; never take down a worker
+            }
+            task = nullptr;
+
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (--pending == 0) idle.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        if (stopping && pending == 0) return;
+        wake.wait(lock, [this] { return queued > 0 || (stopping && pending == 0); });
+        if (stopping && pending == 0) return;
+    }
+}
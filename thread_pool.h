@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. A worker runs its
+// own tasks newest-first and, when it runs dry, steals the oldest task
+// from another worker, so uneven programs (one long loop among many tiny
+// ones) still keep every core busy. Tasks must not throw.
+class ThreadPool {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex stateMutex;
+    std::condition_variable wake;   // work arrived or shutting down
+    std::condition_variable idle;   // pending reached zero
+    std::atomic<size_t> queued;     // tasks sitting in some deque
+    size_t pending = 0;             // submitted and not yet finished
+    bool stopping = false;
+    std::atomic<unsigned> nextQueue;
+
+    bool popLocal(unsigned self, std::function<void()>& task);
+    bool steal(unsigned self, std::function<void()>& task);
+    void workerLoop(unsigned self);
+
+public:
+    // threads == 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();  // blocks until every submitted task has finished
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+};
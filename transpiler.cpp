@@ -0,0 +1,356 @@
+#include "transpiler.h"
+#include "bangla_text.h"
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// Support code at the top of every generated file. The placeholders in
+// <<...>> are replaced with escaped Bangla text, so the generated file is
+// plain ASCII whatever the compiler's input charset.
+static const char* const PRELUDE = R"(// Generated by bangla_compiler. Rebuild from the Bangla source instead of editing.
+#include <climits>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+std::string output;
+
+inline void flushOutput() {
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    std::fflush(stdout);
+    output.clear();
+}
+
+inline void emit(const std::string& line) {
+    output += line;
+    if (output.size() >= 65536) flushOutput();
+}
+
+inline void printNumber(int value) {
+    emit(<<PRINT>> + std::to_string(value) + "\n");
+}
+
+inline void printText(const std::string& text) {
+    emit(<<PRINT>> + text + "\n");
+}
+
+inline void vowelCheck(bool found) {
+    emit(std::string(<<VOWEL>>) + (found ? <<YES>> : <<NO>>) + "\n");
+}
+
+inline int fail(const char* message) {
+    throw std::runtime_error(message);
+}
+
+// Braced initializers are evaluated left to right, which pins down the
+// operand order the interpreter uses
+struct Operands {
+    int first, second;
+};
+
+inline int add(Operands o) { return static_cast<int>(static_cast<unsigned>(o.first) + static_cast<unsigned>(o.second)); }
+inline int sub(Operands o) { return static_cast<int>(static_cast<unsigned>(o.first) - static_cast<unsigned>(o.second)); }
+inline int mul(Operands o) { return static_cast<int>(static_cast<unsigned>(o.first) * static_cast<unsigned>(o.second)); }
+
+// The divisor is evaluated and checked before the dividend
+inline int divisor(int d) {
+    if (d == 0) throw std::runtime_error("Division by zero");
+    return d;
+}
+inline int divide(Operands o) {
+    if (o.first == -1 && o.second == INT_MIN) return fail("Integer overflow");
+    return o.second / o.first;
+}
+
+inline bool eq(Operands o) { return o.first == o.second; }
+inline bool ne(Operands o) { return o.first != o.second; }
+inline bool lt(Operands o) { return o.first < o.second; }
+inline bool gt(Operands o) { return o.first > o.second; }
+
+)";
+
+static void replaceAll(std::string& text, const std::string& from, const std::string& to) {
+    for (size_t at = text.find(from); at != std::string::npos; at = text.find(from, at + to.size())) {
+        text.replace(at, from.size(), to);
+    }
+}
+
+void Transpiler::line(const std::string& text) {
+    code.append(4 * indent, ' ');
+    code += text;
+    code += '\n';
+}
+
+// C++ string literal for arbitrary bytes; everything outside printable
+// ASCII becomes a three-digit octal escape
+std::string Transpiler::literal(const char* data, size_t size) {
+    static const char digits[] = "01234567";
+    std::string out = "\"";
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\' && c != '?') {
+            out += static_cast<char>(c);
+        } else {
+            out += '\\';
+            out += digits[c >> 6];
+            out += digits[(c >> 3) & 7];
+            out += digits[c & 7];
+        }
+    }
+    out += '"';
+    return out;
+}
+
+// Queues first, middle, second and end to be written in that order
+void Transpiler::then(const ASTNode* first, const char* middle, const ASTNode* second, const char* end) {
+    pieces.push_back(Piece{nullptr, end});
+    pieces.push_back(Piece{second, nullptr});
+    pieces.push_back(Piece{nullptr, middle});
+    pieces.push_back(Piece{first, nullptr});
+}
+
+// Written left to right from a work list of nodes and the text between
+// them, so deep expressions use no native stack
+std::string Transpiler::expression(const ASTNode* root) {
+    std::string text;
+    // Expressions contain no statements, so this never nests
+    pieces.clear();
+    pieces.push_back(Piece{root, nullptr});
+
+    while (!pieces.empty()) {
+        Piece piece = pieces.back();
+        pieces.pop_back();
+        if (piece.text) {
+            text += piece.text;
+            continue;
+        }
+        const ASTNode* node = piece.node;
+        if (!node) {
+            text += "0";
+            continue;
+        }
+
+        switch (node->type) {
+            case TokenType::NUM:
+                if (node->value == INT_MIN) text += "(-2147483647 - 1)";
+                else text += std::to_string(node->value);
+                break;
+
+            case TokenType::STRING:
+                // Strings evaluate to their length
+                text += std::to_string(node->text.length());
+                break;
+
+            case TokenType::BORNO:
+                text += std::to_string(runTextQuery(node->value, node->left->text.data, node->left->text.length()));
+                break;
+
+            case TokenType::IDENTIFIER:
+                text += "v[" + std::to_string(node->slot) + "]";
+                break;
+
+            case TokenType::PLUS:
+            case TokenType::JOG:
+                text += "add({";
+                then(node->left, ", ", node->right, "})");
+                break;
+
+            case TokenType::MINUS:
+            case TokenType::BIYOG:
+                text += "sub({";
+                then(node->left, ", ", node->right, "})");
+                break;
+
+            case TokenType::MUL:
+            case TokenType::GUN:
+                text += "mul({";
+                then(node->left, ", ", node->right, "})");
+                break;
+
+            case TokenType::DIV:
+            case TokenType::BHAG:
+                text += "divide({divisor(";
+                then(node->right, "), ", node->left, "})");
+                break;
+
+            case TokenType::ASSIGN:
+                text += "(v[" + std::to_string(node->slot) + "] = ";
+                pieces.push_back(Piece{nullptr, ")"});
+                pieces.push_back(Piece{node->right, nullptr});
+                break;
+
+            default:
+                // Comparisons (and anything else) are not values
+                text += "fail(\"Unknown node type\")";
+                break;
+        }
+    }
+    return text;
+}
+
+std::string Transpiler::condition(const ASTNode* node) {
+    if (!node) return "false";
+
+    const char* compare;
+    switch (node->type) {
+        case TokenType::EQ: compare = "eq"; break;
+        case TokenType::NEQ: compare = "ne"; break;
+        case TokenType::LT: compare = "lt"; break;
+        case TokenType::GT: compare = "gt"; break;
+        default:
+            // Not a comparison: operands still run, the condition is false
+            return "((void)" + expression(node->left) + ", (void)" + expression(node->right) + ", false)";
+    }
+    return std::string(compare) + "({" + expression(node->left) + ", " + expression(node->right) + "})";
+}
+
+// যদি and যতক্ষণ run the children of their body node, whatever it is
+void Transpiler::body(const ASTNode* node) {
+    if (!node) return;
+    for (const ASTNode* child : node->children) {
+        statement(child);
+    }
+}
+
+void Transpiler::statement(const ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case TokenType::LEKHO:
+            if (node->left->type == TokenType::STRING) {
+                line("printText(std::string(" + literal(node->left->text.data, node->left->text.length()) +
+                     ", " + std::to_string(node->left->text.length()) + "));");
+            } else {
+                line("printNumber(" + expression(node->left) + ");");
+            }
+            break;
+
+        case TokenType::SHOROBORNO:
+            // Decided here: the generated code only prints the answer
+            line(containsVowel(node->left->text.data, node->left->text.length()) ? "vowelCheck(true);"
+                                                                                 : "vowelCheck(false);");
+            break;
+
+        case TokenType::JODI: // যদি (if)
+            line("if (" + condition(node->left) + ") {");
+            indent++;
+            body(node->right);
+            indent--;
+            if (node->extra) {
+                line("} else {");
+                indent++;
+                body(node->extra);
+                indent--;
+            }
+            line("}");
+            break;
+
+        case TokenType::JOTOKKHON: // যতক্ষণ (while)
+            line("while (" + condition(node->left) + ") {");
+            indent++;
+            body(node->right);
+            indent--;
+            line("}");
+            break;
+
+        case TokenType::PROTIBAR: // প্রতিবার (for)
+            line("{");
+            indent++;
+            if (node->left) line("(void)" + expression(node->left) + ";");
+            if (node->right) {
+                line("while (" + condition(node->right) + ") {");
+                indent++;
+                for (const ASTNode* child : node->children) {
+                    statement(child);
+                }
+                if (node->extra) line("(void)" + expression(node->extra) + ";");
+                indent--;
+                line("}");
+            }
+            indent--;
+            line("}");
+            break;
+
+        case TokenType::LBRACE:
+            line("{");
+            indent++;
+            body(node);
+            indent--;
+            line("}");
+            break;
+
+        default:
+            // Expression statement
+            line("(void)" + expression(node) + ";");
+            break;
+    }
+}
+
+std::string Transpiler::transpile(const Program& program) {
+    std::string prelude = PRELUDE;
+    replaceAll(prelude, "<<PRINT>>", "std::string(" + literal("লেখ: ", sizeof("লেখ: ") - 1) + ")");
+    replaceAll(prelude, "<<VOWEL>>", literal("স্বরবর্ণ আছে: ", sizeof("স্বরবর্ণ আছে: ") - 1));
+    replaceAll(prelude, "<<YES>>", literal("হ্যাঁ", sizeof("হ্যাঁ") - 1));
+    replaceAll(prelude, "<<NO>>", literal("না", sizeof("না") - 1));
+
+    code = prelude;
+    indent = 0;
+
+    // One slot per variable, as in the interpreter
+    size_t slots = program.slotNames.empty() ? 1 : program.slotNames.size();
+    line("int v[" + std::to_string(slots) + "];");
+    line("");
+    line("void run() {");
+    indent++;
+    if (program.root) body(program.root);
+    indent--;
+    line("}");
+    line("");
+    line("}  // namespace");
+    line("");
+    line("int main() {");
+    indent++;
+    line("try {");
+    line("    run();");
+    line("} catch (const std::exception& e) {");
+    line("    flushOutput();");
+    line("    std::fprintf(stderr, \"%s%s\\n\", " + literal("ত্রুটি: ", sizeof("ত্রুটি: ") - 1) + ", e.what());");
+    line("    return 1;");
+    line("}");
+    line("flushOutput();");
+    line("return 0;");
+    indent--;
+    line("}");
+
+    std::string result;
+    result.swap(code);
+    return result;
+}
+
+int buildExecutable(const Program& program, const std::string& cppPath,
+                    const std::string& exePath) {
+    Transpiler transpiler;
+    std::ofstream file(cppPath.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot write " << cppPath << "\n";
+        return 1;
+    }
+    file << transpiler.transpile(program);
+    file.close();
+
+    const char* cxx = std::getenv("CXX");
+    std::string command = std::string(cxx && *cxx ? cxx : "g++") +
+                          " -O2 -std=c++11 -o \"" + exePath + "\" \"" + cppPath + "\"";
+#ifdef _WIN32
+    command += " -static-libgcc -static-libstdc++";
+#endif
+    int status = std::system(command.c_str());
+    if (status != 0) {
+        std::cerr << "Compiler failed: " << command << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "parser.h"
+#include <string>
+#include <vector>
+
+// Ahead-of-time backend: turns a parsed program into one standalone C++
+// translation unit with no dependency on this project. The generated code
+// keeps Evaluator's semantics, including evaluation order, wrap-around
+// arithmetic, the divisor being checked before the dividend is evaluated,
+// and the quirks of conditions and non-block bodies. So the built binary
+// prints exactly what the interpreter prints. Errors go to stderr with exit
+// status 1. Execution limits do not apply to the built binary.
+class Transpiler {
+    std::string code;
+    int indent = 0;
+
+    // Work list of expression(): a node, or text to write
+    struct Piece {
+        const ASTNode* node;
+        const char* text;
+    };
+    std::vector<Piece> pieces;
+
+    void line(const std::string& text);
+    static std::string literal(const char* data, size_t size);
+
+    void then(const ASTNode* first, const char* middle, const ASTNode* second, const char* end);
+    std::string expression(const ASTNode* root);
+    std::string condition(const ASTNode* node);
+    void statement(const ASTNode* node);
+    void body(const ASTNode* node);
+
+public:
+    std::string transpile(const Program& program);
+};
+
+// Writes program's C++ to cppPath and compiles it into exePath with g++
+// (or $CXX), the toolchain run.bat uses. Returns 0 on success.
+int buildExecutable(const Program& program, const std::string& cppPath,
+                    const std::string& exePath);
@@ -0,0 +1,161 @@
+#include "vm.h"
+#include "bangla_text.h"
+#include "counted_loop.h"
+#include <climits>
+#include <stdexcept>
+#include <vector>
+
+void VM::run(const ChunkView& chunk) {
+    std::vector<int> slots(chunk.slotCount, 0);
+    for (size_t i = 0; i < chunk.nameCount; i++) {
+        auto it = variables.find(chunk.name(i));
+        if (it != variables.end()) slots[i] = it->second;
+    }
+
+    budget.start(limits);
+    // Temporaries are the compiler's doing, so only variables count
+    budget.chargeMemory(chunk.nameCount * sizeof(int));
+
+    std::vector<int> stack(chunk.maxStack + 1);
+    int* sp = stack.data();
+    int* vars = slots.data();
+    const Instruction* code = chunk.code;
+    const LoopSpec* loops = chunk.loops;
+    size_t pc = 0;
+
+    try {
+        for (;;) {
+            const Instruction& ins = code[pc++];
+
+            switch (ins.op) {
+                case OpCode::PUSH:
+                    *sp++ = ins.arg;
+                    break;
+
+                case OpCode::LOAD:
+                    *sp++ = vars[ins.arg];
+                    break;
+
+                case OpCode::STORE:
+                    vars[ins.arg] = sp[-1];
+                    break;
+
+                case OpCode::POP:
+                    sp--;
+                    break;
+
+                case OpCode::ADD: sp--; sp[-1] = sp[-1] + sp[0]; break;
+                case OpCode::SUB: sp--; sp[-1] = sp[-1] - sp[0]; break;
+                case OpCode::MUL: sp--; sp[-1] = sp[-1] * sp[0]; break;
+
+                case OpCode::DIV:
+                    {
+                        int left = *--sp;
+                        int right = sp[-1];
+                        if (right == 0) throw std::runtime_error("Division by zero");
+                        if (right == -1 && left == INT_MIN) throw std::runtime_error("Integer overflow");
+                        sp[-1] = left / right;
+                        break;
+                    }
+
+                case OpCode::CHECK_DIVISOR:
+                    if (sp[-1] == 0) throw std::runtime_error("Division by zero");
+                    break;
+
+                case OpCode::EQ: sp--; sp[-1] = sp[-1] == sp[0]; break;
+                case OpCode::NEQ: sp--; sp[-1] = sp[-1] != sp[0]; break;
+                case OpCode::LT: sp--; sp[-1] = sp[-1] < sp[0]; break;
+                case OpCode::GT: sp--; sp[-1] = sp[-1] > sp[0]; break;
+
+                case OpCode::JUMP:
+                    pc = ins.arg;
+                    break;
+
+                case OpCode::LOOP:
+                    budget.onBackEdge();
+                    pc = ins.arg;
+                    break;
+
+                case OpCode::JUMP_IF_FALSE:
+                    if (!*--sp) pc = ins.arg;
+                    break;
+
+                case OpCode::FOR_TEST:
+                    {
+                        const LoopSpec& loop = loops[ins.arg];
+                        int bound = loop.boundIsSlot ? vars[loop.bound] : loop.bound;
+                        int i = vars[loop.slot];
+                        bool more;
+                        switch (loop.compare) {
+                            case OpCode::EQ: more = i == bound; break;
+                            case OpCode::NEQ: more = i != bound; break;
+                            case OpCode::LT: more = i < bound; break;
+                            default: more = i > bound; break;
+                        }
+                        if (!more) pc = loop.exit;
+                        break;
+                    }
+
+                case OpCode::FOR_NEXT:
+                    {
+                        const LoopSpec& loop = loops[ins.arg];
+                        vars[loop.slot] = countedLoopStep(vars[loop.slot], loop.step);
+                        budget.onBackEdge();
+                        pc = loop.test;
+                        break;
+                    }
+
+                case OpCode::PRINT:
+                    {
+                        int val = *--sp;
+                        budget.chargeMemory(sizeof("লেখ: ") + decimalLength(val));
+                        printNumberLine(*out, val);
+                        break;
+                    }
+
+                case OpCode::PRINT_STR:
+                    {
+                        StringRef text = chunk.string(ins.arg);
+                        budget.chargeMemory(sizeof("লেখ: ") + text.size);
+                        printTextLine(*out, text.data, text.size);
+                        break;
+                    }
+
+                case OpCode::VOWEL_CHECK:
+                    {
+                        StringRef text = chunk.string(ins.arg);
+                        bool hasVowel = containsVowel(text.data, text.size);
+                        budget.chargeMemory(sizeof("স্বরবর্ণ আছে: হ্যাঁ"));
+                        printVowelLine(*out, hasVowel);
+                        break;
+                    }
+
+                case OpCode::FAIL:
+                    throw std::runtime_error(chunk.string(ins.arg).str());
+
+                case OpCode::HALT:
+                    for (size_t i = 0; i < chunk.nameCount; i++) {
+                        variables[chunk.name(i)] = slots[i];
+                    }
+                    out->flush();
+                    return;
+            }
+        }
+    } catch (...) {
+        // Keep whatever state the program reached before failing
+        for (size_t i = 0; i < chunk.nameCount; i++) {
+            variables[chunk.name(i)] = slots[i];
+        }
+        out->flush();
+        throw;
+    }
+}
+
+void VM::setVariable(const std::string& name, int value) {
+    variables[name] = value;
+}
+
+int VM::getVariable(const std::string& name) {
+    auto it = variables.find(name);
+    return it == variables.end() ? 0 : it->second;
+}
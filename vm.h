@@ -0,0 +1,26 @@
+#pragma once
+#include "bytecode.h"
+#include "exec_limits.h"
+#include "output.h"
+#include <unordered_map>
+#include <string>
+
+// Executes a Chunk produced by Compiler, or one mapped from a program file
+// (see program_file.h). Variables live in a flat array indexed by the
+// parser's slots; the name map is only touched when a run starts and ends.
+class VM {
+    std::unordered_map<std::string, int> variables;
+    OutputSink* out;
+    ExecutionLimits limits;
+    ExecutionBudget budget;
+
+public:
+    VM() : out(&standardOutput()) {}
+    void setOutput(OutputSink& sink) { out = &sink; }
+    void setLimits(const ExecutionLimits& newLimits) { limits = newLimits; }
+
+    void run(const ChunkView& chunk);
+    void run(const Chunk& chunk) { run(chunk.view()); }
+    void setVariable(const std::string& name, int value);
+    int getVariable(const std::string& name);
+};